@@ -0,0 +1,278 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <GL/gl.h>
+
+#include "animate.h"
+#include "debug.h"
+#include "extension.h"
+#include "matrix.h"
+#include "pack.h"
+#include "program.h"
+#include "resource.h"
+#include "stats.h"
+#include "trace.h"
+#include "util.h"
+
+// Per-object animation state, laid out as in the compute shader:
+struct object {
+	float axis[3];
+	float speed;
+	float pos[3];
+	float angle;
+	float scale;
+	float pad[3];
+};
+
+static struct {
+	enum animate_mode	 mode;
+	size_t			 count;
+	GLuint			 program;
+	GLint			 loc_count;
+	GLuint			 ssbo[2];
+	struct object		*objects;
+	float			*matrices;
+	struct animate_stats	 stats;
+} state;
+
+static const char *modes[] = {
+	[ANIMATE_CPU] = "cpu",
+	[ANIMATE_GPU] = "gpu",
+};
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool
+animate_mode_parse (const char *name, enum animate_mode *mode)
+{
+	FOREACH (modes, m)
+		if (strcmp(*m, name) == 0) {
+			*mode = m - modes;
+			return true;
+		}
+
+	return false;
+}
+
+const char *
+animate_mode_name (enum animate_mode mode)
+{
+	return modes[mode];
+}
+
+// Place the objects on a centered cubic grid that fits the unit cube, and
+// give each a pseudorandom axis, angular velocity and starting angle:
+static void
+init_objects (struct object *objects, size_t count)
+{
+	int side = ceil(cbrt(count));
+	float spacing = 1.0f / side;
+
+	srand(1);
+
+	for (size_t i = 0; i < count; i++) {
+		struct object *o = &objects[i];
+
+		o->axis[0] = rand() / (float) RAND_MAX - 0.5f;
+		o->axis[1] = rand() / (float) RAND_MAX + 0.1f;
+		o->axis[2] = rand() / (float) RAND_MAX - 0.5f;
+		o->speed   = 0.005f + 0.025f * rand() / (float) RAND_MAX;
+		o->angle   = 2 * M_PI * rand() / (float) RAND_MAX;
+
+		o->pos[0] = ((i % side) + 0.5f) * spacing - 0.5f;
+		o->pos[1] = ((i / side % side) + 0.5f) * spacing - 0.5f;
+		o->pos[2] = ((i / side / side) + 0.5f) * spacing - 0.5f;
+
+		// A single object keeps the original cube's size:
+		o->scale = count == 1 ? 1.0f : spacing * 0.6f;
+	}
+
+	// A single object sits at the origin:
+	if (count == 1)
+		memset(objects[0].pos, 0, sizeof(objects[0].pos));
+}
+
+// Create the state and matrix buffers for the given number of objects:
+bool
+animate_init (size_t count, enum animate_mode mode)
+{
+	TRACE_FUNC();
+
+	// Shader storage buffers need OpenGL 4.3:
+	if (!extension_version(430) || !program_cube_inst_available()) {
+		fputs("Animation needs OpenGL 4.3\n", stderr);
+		return false;
+	}
+
+	// The GPU path needs the compute shader:
+	size_t size;
+	const uint8_t *src = NULL;
+
+	if (mode == ANIMATE_GPU && (src = pack_get("shaders/animate/compute.glsl", &size)) == NULL)
+		return false;
+
+	state.mode     = mode;
+	state.count    = count;
+	state.objects  = calloc(count, sizeof(struct object));
+	state.matrices = mode == ANIMATE_CPU ? calloc(count, 16 * sizeof(float)) : NULL;
+
+	if (state.objects == NULL || (mode == ANIMATE_CPU && state.matrices == NULL)) {
+		fprintf(stderr, "Could not allocate %zu objects\n", count);
+		free(state.objects);
+		free(state.matrices);
+		memset(&state, 0, sizeof(state));
+		return false;
+	}
+
+	init_objects(state.objects, count);
+
+	FOREACH (state.ssbo, b)
+		*b = resource_create(RESOURCE_BUFFER, "animate");
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, state.ssbo[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(struct object),
+		state.objects, GL_STATIC_DRAW);
+	resource_size(RESOURCE_BUFFER, state.ssbo[0], count * sizeof(struct object));
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, state.ssbo[1]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, count * 16 * sizeof(float), NULL,
+		mode == ANIMATE_CPU ? GL_STREAM_DRAW : GL_DYNAMIC_COPY);
+	resource_size(RESOURCE_BUFFER, state.ssbo[1], count * 16 * sizeof(float));
+
+	// The GPU path advances the state on the GPU only; the CPU copy
+	// is kept for the static bounds:
+	if (mode == ANIMATE_GPU) {
+		state.program = program_compute_create("animate", src, src + size);
+
+		state.loc_count = glGetUniformLocation(state.program, "count");
+	}
+
+	memset(&state.stats, 0, sizeof(state.stats));
+	return true;
+}
+
+static void
+step_cpu (void)
+{
+	for (size_t i = 0; i < state.count; i++) {
+		struct object *o = &state.objects[i];
+		float *m = &state.matrices[i * 16];
+
+		o->angle += o->speed;
+
+		mat_rotate(m, o->axis[0], o->axis[1], o->axis[2], o->angle);
+
+		for (int c = 0; c < 3; c++)
+			for (int r = 0; r < 3; r++)
+				m[c * 4 + r] *= o->scale;
+
+		m[12] = o->pos[0];
+		m[13] = o->pos[1];
+		m[14] = o->pos[2];
+	}
+
+	size_t size = state.count * 16 * sizeof(float);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, state.ssbo[1]);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, state.matrices);
+	DEBUG_UPLOAD(state.ssbo[1], 0, state.matrices, size);
+
+	state.stats.upload_bytes += size;
+}
+
+static void
+step_gpu (void)
+{
+	glUseProgram(state.program);
+	glUniform1ui(state.loc_count, state.count);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, state.ssbo[0]);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, state.ssbo[1]);
+
+	glDispatchCompute((state.count + 63) / 64, 1, 1);
+
+	// Make the matrices visible to the vertex shader:
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Advance all objects by one frame and update their model matrices:
+void
+animate_step (void)
+{
+	TRACE_FUNC();
+
+	double start = now();
+
+	if (state.mode == ANIMATE_CPU)
+		step_cpu();
+	else
+		step_gpu();
+
+	state.stats.cpu_seconds += now() - start;
+	state.stats.steps++;
+}
+
+// Bind the model matrices for the instanced cube program:
+void
+animate_bind (void)
+{
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, state.ssbo[1]);
+
+	stats_count(STAT_BUFFERS, 1);
+}
+
+// Get an object's bounding sphere, which does not change as it rotates:
+void
+animate_bounds (size_t index, float *center, float *radius)
+{
+	const struct object *o = &state.objects[index];
+
+	center[0] = o->pos[0];
+	center[1] = o->pos[1];
+	center[2] = o->pos[2];
+
+	// Shapes fit in a unit cube:
+	*radius = o->scale * sqrtf(3.0f) / 2;
+}
+
+size_t
+animate_count (void)
+{
+	return state.count;
+}
+
+void
+animate_stats (struct animate_stats *stats)
+{
+	*stats = state.stats;
+}
+
+void
+animate_destroy (void)
+{
+	if (state.count == 0)
+		return;
+
+	FOREACH (state.ssbo, b)
+		resource_delete(RESOURCE_BUFFER, *b);
+
+	resource_delete(RESOURCE_PROGRAM, state.program);
+
+	free(state.objects);
+	free(state.matrices);
+
+	memset(&state, 0, sizeof(state));
+}
@@ -0,0 +1,24 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+enum animate_mode {
+	ANIMATE_CPU,
+	ANIMATE_GPU,
+};
+
+// Accumulated over all steps since animate_init():
+struct animate_stats {
+	size_t	steps;
+	double	cpu_seconds;
+	size_t	upload_bytes;
+};
+
+bool animate_mode_parse (const char *name, enum animate_mode *mode);
+const char *animate_mode_name (enum animate_mode mode);
+bool animate_init (size_t count, enum animate_mode mode);
+void animate_step (void);
+void animate_bind (void);
+void animate_bounds (size_t index, float *center, float *radius);
+size_t animate_count (void);
+void animate_stats (struct animate_stats *stats);
+void animate_destroy (void);
@@ -1,10 +1,19 @@
+#include <stdbool.h>
+#include <stdio.h>
+
 #include <gdk/gdk.h>
 #include <GL/gl.h>
 
+#include "debug.h"
+#include "pack.h"
 #include "program.h"
+#include "resource.h"
+#include "stats.h"
+#include "trace.h"
 
 static GLuint texture;
 static GLuint vao, vbo;
+static GdkPixbuf *pixbuf;
 
 // Each vertex has space and texture coordinates:
 struct vertex {
@@ -17,6 +26,8 @@ struct vertex {
 void
 background_set_window (int width, int height)
 {
+	TRACE_FUNC();
+
 	float wd = (float)width / 16;
 	float ht = (float)height / 16;
 
@@ -43,6 +54,8 @@ background_set_window (int width, int height)
 
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex), vertex, GL_STATIC_DRAW);
+	DEBUG_UPLOAD(vbo, 0, vertex, sizeof(vertex));
+	resource_size(RESOURCE_BUFFER, vbo, sizeof(vertex));
 
 	glVertexAttribPointer(loc_vertex, 2, GL_FLOAT, GL_FALSE,
 		sizeof(struct vertex),
@@ -58,6 +71,14 @@ background_set_window (int width, int height)
 void
 background_draw (void)
 {
+	TRACE_FUNC();
+
+	// Without an image, clear to black:
+	if (texture == 0) {
+		glClear(GL_COLOR_BUFFER_BIT);
+		return;
+	}
+
 	// Array of indices. We define two counterclockwise triangles:
 	// 0-2-3 and 2-0-1
 	static GLubyte index[6] = {
@@ -71,40 +92,61 @@ background_draw (void)
 	glBindVertexArray(vao);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_BYTE, index);
 	glBindVertexArray(0);
+
+	stats_count(STAT_TEXTURES, 1);
+	stats_count(STAT_VERTEX_ARRAYS, 1);
+	stats_count(STAT_DRAWS, 1);
 }
 
-void
-background_init (void)
+// Decode the background image. Touches no GL state, so it is safe to call
+// from a worker thread. Returns false if there is no image to upload:
+bool
+background_decode (void)
 {
-	// Inline data declaration:
-	extern char _binary_textures_background_png_start[];
-	extern char _binary_textures_background_png_end[];
+	TRACE_FUNC();
+
+	size_t len;
+	GError *error = NULL;
+	const uint8_t *start = pack_get("textures/background.png", &len);
 
-	char *start = _binary_textures_background_png_start;
-	size_t len = _binary_textures_background_png_end
-		   - _binary_textures_background_png_start;
+	if (start == NULL)
+		return false;
 
 	GInputStream *stream;
-	GdkPixbuf *pixbuf;
 
-	// Create an input stream from inline data:
+	// Create an input stream from the asset:
 	stream = g_memory_input_stream_new_from_data(start, len, NULL);
 
 	// Generate a pixbuf from the input stream:
-	pixbuf = gdk_pixbuf_new_from_stream(stream, NULL, NULL);
+	pixbuf = gdk_pixbuf_new_from_stream(stream, NULL, &error);
 
 	// Destroy the stream:
 	g_object_unref(stream);
 
-	// Generate an OpenGL texture from pixbuf;
-	// hack a bit by not accounting for pixbuf rowstride:
-	glGenTextures(1, &texture);
+	if (pixbuf == NULL) {
+		fprintf(stderr, "Could not decode background: %s\n", error->message);
+		g_clear_error(&error);
+		return false;
+	}
+
+	return true;
+}
+
+// Generate an OpenGL texture from the decoded image:
+static void
+upload_texture (void)
+{
+	// Hack a bit by not accounting for pixbuf rowstride:
+	int width  = gdk_pixbuf_get_width(pixbuf);
+	int height = gdk_pixbuf_get_height(pixbuf);
+
+	texture = resource_create(RESOURCE_TEXTURE, "background");
 	glBindTexture(GL_TEXTURE_2D, texture);
 
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
-		gdk_pixbuf_get_width(pixbuf),
-		gdk_pixbuf_get_height(pixbuf), 0, GL_RGB, GL_UNSIGNED_BYTE,
-		gdk_pixbuf_get_pixels(pixbuf));
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0,
+		GL_RGB, GL_UNSIGNED_BYTE, gdk_pixbuf_get_pixels(pixbuf));
+
+	resource_size(RESOURCE_TEXTURE, texture, (size_t) width * height * 3);
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -112,9 +154,45 @@ background_init (void)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
-	// Generate empty buffer:
-	glGenBuffers(1, &vbo);
+	// The texture holds its own copy now:
+	g_object_unref(pixbuf);
+	pixbuf = NULL;
+}
+
+// Upload the decoded image, if any, and create the buffers:
+void
+background_upload (void)
+{
+	TRACE_FUNC();
+
+	if (pixbuf != NULL)
+		upload_texture();
+
+	// The quad is set up either way; generate empty buffer:
+	vbo = resource_create(RESOURCE_BUFFER, "background");
 
 	// Generate empty vertex array object:
-	glGenVertexArrays(1, &vao);
+	vao = resource_create(RESOURCE_VERTEX_ARRAY, "background");
+}
+
+bool
+background_init (void)
+{
+	TRACE_FUNC();
+
+	bool decoded = background_decode();
+
+	background_upload();
+	return decoded;
+}
+
+// Delete the GL objects, as when the GL context goes away:
+void
+background_destroy (void)
+{
+	resource_delete(RESOURCE_TEXTURE, texture);
+	resource_delete(RESOURCE_BUFFER, vbo);
+	resource_delete(RESOURCE_VERTEX_ARRAY, vao);
+
+	texture = vbo = vao = 0;
 }
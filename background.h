@@ -1,3 +1,8 @@
+#include <stdbool.h>
+
 void background_draw (void);
-void background_init (void);
+bool background_init (void);
+bool background_decode (void);
+void background_upload (void);
 void background_set_window (int width, int height);
+void background_destroy (void);
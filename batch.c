@@ -0,0 +1,572 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <GL/gl.h>
+
+#include "vertex.h"
+#include "batch.h"
+#include "program.h"
+#include "resource.h"
+#include "stats.h"
+#include "trace.h"
+#include "util.h"
+
+// Capacity of each shared vertex and index buffer:
+#define POOL_VERTICES	(1 << 20)
+#define POOL_INDICES	(1 << 22)
+
+// A free range of a buffer, in elements:
+struct range {
+	size_t	start;
+	size_t	size;
+};
+
+// Free ranges sorted by start, so that neighbours can be merged:
+struct allocator {
+	struct range	*free;
+	size_t		 count;
+	size_t		 alloc;
+};
+
+// Large vertex and index buffers shared by many meshes:
+struct pool {
+	GLuint			vao;
+	GLuint			vbo;
+	GLuint			ibo;
+	struct allocator	vertices;
+	struct allocator	indices;
+};
+
+// A mesh is a range of vertices and of indices in one pool:
+struct batch_mesh {
+	bool	used;
+	int	pool;
+	size_t	base_vertex;
+	size_t	nvert;
+	size_t	first_index;
+	size_t	nindex;
+};
+
+// A queued draw, and the state key it is sorted by:
+struct draw {
+	struct batch_state	state;
+	int			pool;
+	int			mesh;
+};
+
+static struct {
+	struct pool	*pools;
+	size_t		 npools;
+	struct batch_mesh *meshes;
+	size_t		 nmeshes;
+	struct draw	*draws;
+	size_t		 ndraws;
+	size_t		 adraws;
+
+	// Per-group arrays for glMultiDrawElementsBaseVertex:
+	GLsizei		*count;
+	const void	**offset;
+	GLint		*base;
+	size_t		 acount;
+	size_t		 aoffset;
+	size_t		 abase;
+
+	struct batch_stats stats;
+} batch;
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool
+grow (void **array, size_t *alloc, size_t need, size_t size)
+{
+	if (need <= *alloc)
+		return true;
+
+	size_t n = *alloc ? *alloc : 64;
+
+	while (n < need)
+		n *= 2;
+
+	void *p = realloc(*array, n * size);
+
+	if (p == NULL)
+		return false;
+
+	*array = p;
+	*alloc = n;
+	return true;
+}
+
+static bool
+allocator_init (struct allocator *a, size_t size)
+{
+	a->count = 0;
+	a->alloc = 0;
+	a->free  = NULL;
+
+	if (!grow((void **) &a->free, &a->alloc, 1, sizeof(struct range)))
+		return false;
+
+	a->free[a->count++] = (struct range) { 0, size };
+	return true;
+}
+
+// Take the first free range that fits:
+static bool
+allocator_alloc (struct allocator *a, size_t size, size_t *start)
+{
+	FOREACH_NELEM (a->free, a->count, r)
+		if (r->size >= size) {
+			*start = r->start;
+			r->start += size;
+			r->size  -= size;
+
+			if (r->size == 0) {
+				memmove(r, r + 1, (a->free + a->count - r - 1) * sizeof(*r));
+				a->count--;
+			}
+
+			return true;
+		}
+
+	return false;
+}
+
+// Return a range, merging it with its free neighbours:
+static void
+allocator_free (struct allocator *a, size_t start, size_t size)
+{
+	size_t i = 0;
+
+	while (i < a->count && a->free[i].start < start)
+		i++;
+
+	bool prev = i > 0 && a->free[i - 1].start + a->free[i - 1].size == start;
+	bool next = i < a->count && start + size == a->free[i].start;
+
+	if (prev && next) {
+		a->free[i - 1].size += size + a->free[i].size;
+		memmove(&a->free[i], &a->free[i + 1], (a->count - i - 1) * sizeof(struct range));
+		a->count--;
+	}
+	else if (prev)
+		a->free[i - 1].size += size;
+	else if (next) {
+		a->free[i].start = start;
+		a->free[i].size += size;
+	}
+	else {
+		if (!grow((void **) &a->free, &a->alloc, a->count + 1, sizeof(struct range)))
+			return;
+
+		memmove(&a->free[i + 1], &a->free[i], (a->count - i) * sizeof(struct range));
+		a->free[i] = (struct range) { start, size };
+		a->count++;
+	}
+}
+
+static bool
+pool_create (struct pool *p)
+{
+	if (!allocator_init(&p->vertices, POOL_VERTICES) || !allocator_init(&p->indices, POOL_INDICES))
+		return false;
+
+	p->vao = resource_create(RESOURCE_VERTEX_ARRAY, "batch");
+	p->vbo = resource_create(RESOURCE_BUFFER, "batch");
+	p->ibo = resource_create(RESOURCE_BUFFER, "batch");
+
+	glBindVertexArray(p->vao);
+
+	glBindBuffer(GL_ARRAY_BUFFER, p->vbo);
+	glBufferData(GL_ARRAY_BUFFER, POOL_VERTICES * sizeof(struct vertex), NULL, GL_STATIC_DRAW);
+	resource_size(RESOURCE_BUFFER, p->vbo, POOL_VERTICES * sizeof(struct vertex));
+
+	// The element buffer binding is part of the vertex array:
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, p->ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, POOL_INDICES * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+	resource_size(RESOURCE_BUFFER, p->ibo, POOL_INDICES * sizeof(GLuint));
+
+	struct {
+		enum LocStatic	 loc;
+		const void	*ptr;
+	}
+	map[] = {
+		{ LOC_STATIC_VERTEX, (void *) offsetof(struct vertex, pos)    },
+		{ LOC_STATIC_VCOLOR, (void *) offsetof(struct vertex, color)  },
+		{ LOC_STATIC_NORMAL, (void *) offsetof(struct vertex, normal) },
+	};
+
+	FOREACH (map, m) {
+		GLint loc = program_static_loc(m->loc);
+		glEnableVertexAttribArray(loc);
+		glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, sizeof(struct vertex), m->ptr);
+	}
+
+	glBindVertexArray(0);
+	return true;
+}
+
+// Find room for a mesh in an existing pool, or in a new one:
+static bool
+pool_alloc (struct batch_mesh *m)
+{
+	for (size_t i = 0; i <= batch.npools; i++) {
+		if (i == batch.npools) {
+			struct pool *pools = realloc(batch.pools, (i + 1) * sizeof(*pools));
+
+			if (pools == NULL)
+				return false;
+
+			batch.pools = pools;
+
+			if (!pool_create(&batch.pools[i]))
+				return false;
+
+			batch.npools++;
+		}
+
+		struct pool *p = &batch.pools[i];
+
+		if (!allocator_alloc(&p->vertices, m->nvert, &m->base_vertex))
+			continue;
+
+		if (!allocator_alloc(&p->indices, m->nindex, &m->first_index)) {
+			allocator_free(&p->vertices, m->base_vertex, m->nvert);
+			continue;
+		}
+
+		m->pool = i;
+		return true;
+	}
+
+	return false;
+}
+
+// Transform a vertex to world coordinates. The matrix is column major and
+// is assumed to scale uniformly, so normals only need renormalizing:
+static struct vertex
+transform (const struct vertex *v, const float *m)
+{
+	const float p[3] = { v->pos.x,    v->pos.y,    v->pos.z    };
+	const float n[3] = { v->normal.x, v->normal.y, v->normal.z };
+	float op[3], on[3];
+
+	for (int r = 0; r < 3; r++) {
+		op[r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+		on[r] = m[r] * n[0] + m[4 + r] * n[1] + m[8 + r] * n[2];
+	}
+
+	float len = sqrtf(on[0] * on[0] + on[1] * on[1] + on[2] * on[2]);
+
+	return (struct vertex) {
+		.pos    = { op[0], op[1], op[2] },
+		.normal = { on[0] / len, on[1] / len, on[2] / len },
+		.color  = v->color,
+	};
+}
+
+static uint32_t
+hash_vertex (const struct vertex *v)
+{
+	const uint8_t *p = (const uint8_t *) v;
+	uint32_t h = 2166136261u;
+
+	for (size_t i = 0; i < sizeof(*v); i++)
+		h = (h ^ p[i]) * 16777619u;
+
+	return h;
+}
+
+// Merge identical vertices of a triangle list into an indexed mesh. Returns
+// the number of unique vertices:
+static size_t
+make_indexed (const struct vertex *vert, size_t nvert, struct vertex *unique, GLuint *index)
+{
+	size_t size = 1;
+	size_t count = 0;
+
+	while (size < nvert * 2)
+		size *= 2;
+
+	// Open addressing, with one more than the vertex index as the key:
+	GLuint *table = calloc(size, sizeof(GLuint));
+
+	if (table == NULL)
+		return 0;
+
+	for (size_t i = 0; i < nvert; i++) {
+		size_t slot = hash_vertex(&vert[i]) & (size - 1);
+
+		for (;; slot = (slot + 1) & (size - 1)) {
+			if (table[slot] == 0) {
+				unique[count] = vert[i];
+				table[slot] = ++count;
+				break;
+			}
+
+			if (memcmp(&unique[table[slot] - 1], &vert[i], sizeof(*vert)) == 0)
+				break;
+		}
+
+		index[i] = table[slot] - 1;
+	}
+
+	free(table);
+	return count;
+}
+
+// Add a static mesh, given as a triangle list in model coordinates and the
+// matrix that places it in the world. Returns a handle, or -1 on error:
+int
+batch_mesh_add (const struct vertex *vert, size_t nvert, const float *matrix)
+{
+	TRACE_FUNC();
+
+	struct vertex *world = malloc(nvert * sizeof(*world));
+	struct vertex *unique = malloc(nvert * sizeof(*unique));
+	GLuint *index = malloc(nvert * sizeof(*index));
+	int handle = -1;
+
+	if (world == NULL || unique == NULL || index == NULL)
+		goto out;
+
+	for (size_t i = 0; i < nvert; i++)
+		world[i] = transform(&vert[i], matrix);
+
+	struct batch_mesh m = {
+		.used   = true,
+		.nindex = nvert,
+		.nvert  = make_indexed(world, nvert, unique, index),
+	};
+
+	if (m.nvert == 0 || m.nvert > POOL_VERTICES || m.nindex > POOL_INDICES || !pool_alloc(&m))
+		goto out;
+
+	// Reuse a free slot:
+	for (handle = 0; (size_t) handle < batch.nmeshes; handle++)
+		if (!batch.meshes[handle].used)
+			break;
+
+	if ((size_t) handle == batch.nmeshes) {
+		struct batch_mesh *meshes = realloc(batch.meshes, (batch.nmeshes + 1) * sizeof(*meshes));
+
+		if (meshes == NULL) {
+			allocator_free(&batch.pools[m.pool].vertices, m.base_vertex, m.nvert);
+			allocator_free(&batch.pools[m.pool].indices, m.first_index, m.nindex);
+			handle = -1;
+			goto out;
+		}
+
+		batch.meshes = meshes;
+		batch.nmeshes++;
+	}
+
+	batch.meshes[handle] = m;
+
+	const struct pool *p = &batch.pools[m.pool];
+
+	glBindBuffer(GL_ARRAY_BUFFER, p->vbo);
+	glBufferSubData(GL_ARRAY_BUFFER, m.base_vertex * sizeof(struct vertex),
+		m.nvert * sizeof(struct vertex), unique);
+
+	glBindBuffer(GL_COPY_WRITE_BUFFER, p->ibo);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, m.first_index * sizeof(GLuint),
+		m.nindex * sizeof(GLuint), index);
+
+out:	free(world);
+	free(unique);
+	free(index);
+	return handle;
+}
+
+// Whether the handle refers to a mesh that has not been removed:
+static bool
+valid (int handle)
+{
+	return handle >= 0 && (size_t) handle < batch.nmeshes && batch.meshes[handle].used;
+}
+
+// Return a mesh's space to its pool:
+void
+batch_mesh_remove (int handle)
+{
+	if (!valid(handle)) {
+		fprintf(stderr, "Not a batched mesh: %d\n", handle);
+		return;
+	}
+
+	struct batch_mesh *m = &batch.meshes[handle];
+	struct pool *p = &batch.pools[m->pool];
+
+	allocator_free(&p->vertices, m->base_vertex, m->nvert);
+	allocator_free(&p->indices, m->first_index, m->nindex);
+
+	m->used = false;
+}
+
+// Queue a mesh for drawing with the given state:
+void
+batch_draw (int mesh, const struct batch_state *state)
+{
+	if (!valid(mesh)) {
+		fprintf(stderr, "Not a batched mesh: %d\n", mesh);
+		return;
+	}
+
+	if (!grow((void **) &batch.draws, &batch.adraws, batch.ndraws + 1, sizeof(struct draw)))
+		return;
+
+	batch.draws[batch.ndraws++] = (struct draw) {
+		.state = *state,
+		.pool  = batch.meshes[mesh].pool,
+		.mesh  = mesh,
+	};
+}
+
+// Order by program, then material, then vertex array:
+static int
+compare (const void *p, const void *q)
+{
+	const struct draw *a = p, *b = q;
+	uintptr_t pa = (uintptr_t) a->state.program;
+	uintptr_t pb = (uintptr_t) b->state.program;
+
+	if (pa != pb)
+		return pa < pb ? -1 : 1;
+
+	if (a->state.texture != b->state.texture)
+		return a->state.texture < b->state.texture ? -1 : 1;
+
+	if (a->state.layer != b->state.layer)
+		return a->state.layer < b->state.layer ? -1 : 1;
+
+	if (a->pool != b->pool)
+		return a->pool < b->pool ? -1 : 1;
+
+	return a->mesh - b->mesh;
+}
+
+static bool
+same_key (const struct draw *a, const struct draw *b)
+{
+	return a->state.program == b->state.program
+	    && a->state.texture == b->state.texture
+	    && a->state.layer   == b->state.layer
+	    && a->pool          == b->pool;
+}
+
+// Draw all queued meshes. Draws that share a state key are submitted in one
+// multi-draw call, and state is only set where it differs from the previous
+// group:
+void
+batch_submit (void)
+{
+	TRACE_FUNC();
+
+	double start = now();
+	const struct draw *prev = NULL;
+	size_t groups = 0;
+
+	qsort(batch.draws, batch.ndraws, sizeof(struct draw), compare);
+
+	if (!grow((void **) &batch.count,  &batch.acount,  batch.ndraws, sizeof(*batch.count))
+	 || !grow((void **) &batch.offset, &batch.aoffset, batch.ndraws, sizeof(*batch.offset))
+	 || !grow((void **) &batch.base,   &batch.abase,   batch.ndraws, sizeof(*batch.base))) {
+		fprintf(stderr, "Could not allocate %zu draws\n", batch.ndraws);
+		batch.ndraws = 0;
+		return;
+	}
+
+	for (size_t i = 0; i < batch.ndraws; ) {
+		const struct draw *d = &batch.draws[i];
+		size_t n = 0;
+
+		if (prev == NULL || d->state.program != prev->state.program)
+			d->state.program();
+
+		if (prev == NULL || d->state.texture != prev->state.texture) {
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, d->state.texture);
+			stats_count(STAT_TEXTURES, 1);
+		}
+
+		if (prev == NULL || d->state.layer != prev->state.layer || d->state.program != prev->state.program)
+			program_static_layer(d->state.layer);
+
+		if (prev == NULL || d->pool != prev->pool) {
+			glBindVertexArray(batch.pools[d->pool].vao);
+			stats_count(STAT_VERTEX_ARRAYS, 1);
+		}
+
+		// Gather the group:
+		for (; i < batch.ndraws && same_key(d, &batch.draws[i]); i++, n++) {
+			const struct batch_mesh *m = &batch.meshes[batch.draws[i].mesh];
+
+			batch.count[n]  = m->nindex;
+			batch.offset[n] = (const void *) (m->first_index * sizeof(GLuint));
+			batch.base[n]   = m->base_vertex;
+		}
+
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.count, GL_UNSIGNED_INT,
+			batch.offset, n, batch.base);
+
+		stats_count(STAT_DRAWS, 1);
+		prev = d;
+		groups++;
+	}
+
+	glBindVertexArray(0);
+
+	batch.stats = (struct batch_stats) {
+		.pools          = batch.npools,
+		.meshes         = batch.nmeshes,
+		.draws          = batch.ndraws,
+		.groups         = groups,
+		.submit_seconds = now() - start,
+	};
+
+	batch.ndraws = 0;
+}
+
+void
+batch_stats (struct batch_stats *stats)
+{
+	*stats = batch.stats;
+}
+
+// Delete all pools and meshes:
+void
+batch_destroy (void)
+{
+	FOREACH_NELEM (batch.pools, batch.npools, p) {
+		resource_delete(RESOURCE_VERTEX_ARRAY, p->vao);
+		resource_delete(RESOURCE_BUFFER, p->vbo);
+		resource_delete(RESOURCE_BUFFER, p->ibo);
+
+		free(p->vertices.free);
+		free(p->indices.free);
+	}
+
+	free(batch.pools);
+	free(batch.meshes);
+	free(batch.draws);
+	free(batch.count);
+	free(batch.offset);
+	free(batch.base);
+
+	memset(&batch, 0, sizeof(batch));
+}
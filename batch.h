@@ -0,0 +1,25 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+// Render state a static mesh is drawn with:
+struct batch_state {
+	void	(*program) (void);
+	GLuint	  texture;
+	GLint	  layer;
+};
+
+// Counts of the last batch_submit():
+struct batch_stats {
+	size_t	pools;
+	size_t	meshes;
+	size_t	draws;
+	size_t	groups;
+	double	submit_seconds;
+};
+
+int batch_mesh_add (const struct vertex *vert, size_t nvert, const float *matrix);
+void batch_mesh_remove (int mesh);
+void batch_draw (int mesh, const struct batch_state *state);
+void batch_submit (void);
+void batch_stats (struct batch_stats *stats);
+void batch_destroy (void);
@@ -0,0 +1,160 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../model.h"
+#include "../program.h"
+#include "../util.h"
+#include "../view.h"
+#include "headless.h"
+
+// Command line options:
+static struct {
+	int	objects;
+	int	frames;
+	int	width;
+	int	height;
+} opt = {
+	.objects = 10000,
+	.frames  = 20,
+	.width   = 256,
+	.height  = 256,
+};
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Read back the first model matrices, to check that both paths agree:
+static void
+read_matrices (float *m, size_t count)
+{
+	GLint buffer;
+
+	glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, 1, &buffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * 16 * sizeof(float), m);
+}
+
+static void
+run (size_t count, enum animate_mode mode, float *m, size_t nm)
+{
+	struct animate_stats before, after;
+
+	model_set_objects(count, mode);
+
+	// Warm up:
+	for (int i = 0; i < 3; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		model_draw();
+	}
+	glFinish();
+
+	animate_stats(&before);
+	double start = now();
+
+	for (int i = 0; i < opt.frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		model_draw();
+	}
+
+	glFinish();
+	double wall = (now() - start) / opt.frames;
+
+	animate_stats(&after);
+	read_matrices(m, nm);
+
+	printf("    { \"objects\": %zu, \"mode\": \"%s\", \"frame_ms\": %.3f"
+		", \"cpu_ms\": %.4f, \"upload_bytes\": %zu }",
+		count, animate_mode_name(mode), wall * 1e3,
+		(after.cpu_seconds - before.cpu_seconds) * 1e3 / opt.frames,
+		(after.upload_bytes - before.upload_bytes) / opt.frames);
+
+	model_set_objects(0, mode);
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:f:w:h:")) != -1) {
+		switch (c)
+		{
+		case 'n': opt.objects = atoi(optarg); break;
+		case 'f': opt.frames  = atoi(optarg); break;
+		case 'w': opt.width   = atoi(optarg); break;
+		case 'h': opt.height  = atoi(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n objects] [-f frames] [-w width] [-h height]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.objects > 0 && opt.frames > 0 && opt.width > 0 && opt.height > 0;
+}
+
+// Compare CPU and compute shader animation for increasing object counts,
+// up to the given maximum, and report the results as JSON on stdout:
+int
+main (int argc, char **argv)
+{
+	float cpu[16 * 16], gpu[16 * 16];
+	const char *sep = "";
+
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (!headless_init(opt.width, opt.height))
+		return 1;
+
+	programs_init();
+	view_set_window(opt.width, opt.height);
+
+	if (!program_cube_inst_available()) {
+		fputs("Animation needs OpenGL 4.3\n", stderr);
+		return 1;
+	}
+
+	if (!model_init())
+		return 1;
+
+	printf("{\n  \"renderer\": \"%s\",\n  \"frames\": %d,\n  \"results\": [\n",
+		glGetString(GL_RENDERER), opt.frames);
+
+	for (size_t count = 1; count <= (size_t) opt.objects; count *= 10) {
+		size_t nm = count < 16 ? count : 16;
+		float diff = 0.0f;
+
+		fputs(sep, stdout);
+		run(count, ANIMATE_CPU, cpu, nm);
+		puts(",");
+		run(count, ANIMATE_GPU, gpu, nm);
+		sep = ",\n";
+
+		for (size_t i = 0; i < nm * 16; i++)
+			diff = fmaxf(diff, fabsf(cpu[i] - gpu[i]));
+
+		// Both paths must produce the same matrices:
+		if (diff > 1e-3f)
+			fprintf(stderr, "CPU and GPU matrices differ by %g for %zu objects\n", diff, count);
+	}
+
+	puts("\n  ]\n}");
+
+	headless_destroy();
+	return 0;
+}
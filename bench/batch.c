@@ -0,0 +1,268 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../vertex.h"
+#include "../batch.h"
+#include "../material.h"
+#include "../mesh.h"
+#include "../program.h"
+#include "../resource.h"
+#include "../stats.h"
+#include "../view.h"
+#include "headless.h"
+
+// Command line options:
+static struct {
+	int	meshes;
+	int	materials;
+	int	triangles;
+	int	frames;
+	int	width;
+	int	height;
+} opt = {
+	.meshes    = 10000,
+	.materials = 8,
+	.triangles = 200,
+	.frames    = 20,
+	.width     = 512,
+	.height    = 512,
+};
+
+// Each mesh in its own vertex array, as drawn without batching:
+struct single {
+	GLuint	vao;
+	GLuint	vbo;
+	size_t	nvert;
+	GLint	layer;
+	int	handle;
+};
+
+static struct single *singles;
+static GLuint texture;
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+upload_single (struct single *s, const struct vertex *vert, size_t nvert)
+{
+	s->vao   = resource_create(RESOURCE_VERTEX_ARRAY, "bench");
+	s->vbo   = resource_create(RESOURCE_BUFFER, "bench");
+	s->nvert = nvert;
+
+	glBindVertexArray(s->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, s->vbo);
+	glBufferData(GL_ARRAY_BUFFER, nvert * sizeof(struct vertex), vert, GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(program_static_loc(LOC_STATIC_VERTEX));
+	glEnableVertexAttribArray(program_static_loc(LOC_STATIC_VCOLOR));
+	glEnableVertexAttribArray(program_static_loc(LOC_STATIC_NORMAL));
+
+	glVertexAttribPointer(program_static_loc(LOC_STATIC_VERTEX), 3, GL_FLOAT, GL_FALSE,
+		sizeof(struct vertex), (void *) offsetof(struct vertex, pos));
+	glVertexAttribPointer(program_static_loc(LOC_STATIC_VCOLOR), 3, GL_FLOAT, GL_FALSE,
+		sizeof(struct vertex), (void *) offsetof(struct vertex, color));
+	glVertexAttribPointer(program_static_loc(LOC_STATIC_NORMAL), 3, GL_FLOAT, GL_FALSE,
+		sizeof(struct vertex), (void *) offsetof(struct vertex, normal));
+
+	glBindVertexArray(0);
+}
+
+// Generate distinct meshes of varying shape and detail on a grid, and add
+// each both to the batch and to its own vertex array:
+static void
+build_scene (void)
+{
+	int side = ceil(sqrt(opt.meshes));
+	float spacing = 2.0f / side;
+
+	singles = calloc(opt.meshes, sizeof(*singles));
+
+	for (int i = 0; i < opt.meshes; i++) {
+		struct mesh mesh;
+		float scale = spacing * 0.6f;
+		float matrix[16] = {
+			[0]  = scale,
+			[5]  = scale,
+			[10] = scale,
+			[12] = (i % side + 0.5f) * spacing - 1.0f,
+			[13] = (i / side + 0.5f) * spacing - 1.0f,
+			[15] = 1.0f,
+		};
+
+		mesh_generate(&mesh, i % 3, 12 + i * 37 % opt.triangles, 1);
+
+		singles[i].layer  = i % opt.materials;
+		singles[i].handle = batch_mesh_add(mesh.vert, mesh.nvert, matrix);
+
+		// The static program takes world coordinates; the matrix only
+		// scales and translates, so normals stay as they are:
+		for (size_t v = 0; v < mesh.nvert; v++) {
+			struct point *p = &mesh.vert[v].pos;
+
+			p->x = p->x * scale + matrix[12];
+			p->y = p->y * scale + matrix[13];
+			p->z = p->z * scale;
+		}
+
+		upload_single(&singles[i], mesh.vert, mesh.nvert);
+		mesh_free(&mesh);
+	}
+}
+
+// Bind everything and draw, for each mesh:
+static void
+submit_single (void)
+{
+	for (int i = 0; i < opt.meshes; i++) {
+		const struct single *s = &singles[i];
+
+		program_static_use();
+		program_static_layer(s->layer);
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glBindVertexArray(s->vao);
+		glDrawArrays(GL_TRIANGLES, 0, s->nvert);
+	}
+
+	glBindVertexArray(0);
+
+	stats_count(STAT_TEXTURES, opt.meshes);
+	stats_count(STAT_VERTEX_ARRAYS, opt.meshes);
+	stats_count(STAT_DRAWS, opt.meshes);
+}
+
+static void
+submit_batch (void)
+{
+	for (int i = 0; i < opt.meshes; i++) {
+		struct batch_state state = {
+			.program = program_static_use,
+			.texture = texture,
+			.layer   = singles[i].layer,
+		};
+
+		batch_draw(singles[i].handle, &state);
+	}
+
+	batch_submit();
+}
+
+static void
+run (const char *name, void (*submit) (void))
+{
+	size_t counts[STAT_COUNT];
+	double cpu = 0.0;
+
+	// Warm up:
+	for (int i = 0; i < 3; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		submit();
+	}
+	glFinish();
+
+	stats_reset();
+	double start = now();
+
+	for (int i = 0; i < opt.frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		double t = now();
+		submit();
+		cpu += now() - t;
+	}
+
+	glFinish();
+	double wall = (now() - start) / opt.frames;
+
+	stats_get(counts);
+
+	printf("    { \"mode\": \"%s\", \"frame_ms\": %.3f, \"submit_ms\": %.3f",
+		name, wall * 1e3, cpu * 1e3 / opt.frames);
+
+	for (int i = 0; i < STAT_COUNT; i++)
+		printf(", \"%s\": %zu", stats_name(i), counts[i] / opt.frames);
+
+	fputs(" }", stdout);
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:m:t:f:w:h:")) != -1) {
+		switch (c)
+		{
+		case 'n': opt.meshes    = atoi(optarg); break;
+		case 'm': opt.materials = atoi(optarg); break;
+		case 't': opt.triangles = atoi(optarg); break;
+		case 'f': opt.frames    = atoi(optarg); break;
+		case 'w': opt.width     = atoi(optarg); break;
+		case 'h': opt.height    = atoi(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n meshes] [-m materials] [-t triangles] [-f frames] [-w width] [-h height]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.meshes > 0 && opt.materials > 0 && opt.triangles > 0 && opt.frames > 0
+		&& opt.width > 0 && opt.height > 0;
+}
+
+// Draw a scene of distinct static meshes, once with a vertex array and a
+// draw call each and once batched into shared buffers, and report the draw
+// calls, state changes and CPU submit time per frame as JSON on stdout:
+int
+main (int argc, char **argv)
+{
+	struct batch_stats stats;
+
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (!headless_init(opt.width, opt.height))
+		return 1;
+
+	programs_init();
+	view_set_window(opt.width, opt.height);
+
+	if (!program_static_available()) {
+		fputs("Static batching needs OpenGL 4.3\n", stderr);
+		return 1;
+	}
+
+	texture = material_create_array(opt.materials);
+	build_scene();
+
+	printf("{\n  \"renderer\": \"%s\",\n  \"meshes\": %d,\n  \"materials\": %d,"
+		"\n  \"frames\": %d,\n  \"results\": [\n",
+		glGetString(GL_RENDERER), opt.meshes, opt.materials, opt.frames);
+
+	run("single", submit_single);
+	puts(",");
+	run("batch", submit_batch);
+
+	batch_stats(&stats);
+
+	printf("\n  ],\n  \"pools\": %zu,\n  \"groups\": %zu\n}\n", stats.pools, stats.groups);
+
+	headless_destroy();
+	return 0;
+}
@@ -0,0 +1,217 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../graph.h"
+#include "../model.h"
+#include "../post.h"
+#include "../program.h"
+#include "../view.h"
+#include "headless.h"
+
+// Command line options:
+static struct {
+	int	blurs;
+	int	objects;
+	int	frames;
+	int	width;
+	int	height;
+} opt = {
+	.blurs   = 8,
+	.objects = 1000,
+	.frames  = 20,
+	.width   = 1280,
+	.height  = 720,
+};
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Stands in for a pass whose output nobody uses:
+static void
+unused (void)
+{
+}
+
+// Draw the model into an offscreen scene and add a bloom with the given
+// number of blur passes. A pass whose output is never read is added too,
+// for the graph to drop:
+static void
+build (int blurs)
+{
+	int color = GRAPH_BACKBUFFER;
+	int depth = GRAPH_BACKBUFFER_DEPTH;
+
+	if (blurs > 0) {
+		color = graph_attachment("scene", GRAPH_RGBA8, 1.0f);
+		depth = graph_attachment("scene depth", GRAPH_DEPTH, 1.0f);
+	}
+
+	graph_add(&(struct graph_pass) {
+		.name  = "model",
+		.run   = model_draw,
+		.clear = { color, depth },
+	});
+
+	if (blurs > 0) {
+		int debug = graph_attachment("debug", GRAPH_RGBA16F, 1.0f);
+
+		graph_add(&(struct graph_pass) {
+			.name  = "unused",
+			.run   = unused,
+			.read  = { color },
+			.write = { debug },
+		});
+
+		post_add(color, GRAPH_BACKBUFFER, blurs);
+	}
+
+	graph_set_window(opt.width, opt.height);
+	graph_compile();
+}
+
+// Check that a pass clearing the backbuffer also clears its depth:
+static bool
+check_clear (void)
+{
+	GLfloat depth = 0.0f;
+
+	graph_add(&(struct graph_pass) {
+		.name  = "clear",
+		.run   = unused,
+		.clear = { GRAPH_BACKBUFFER, GRAPH_BACKBUFFER_DEPTH },
+	});
+
+	graph_set_window(opt.width, opt.height);
+	graph_compile();
+
+	glClearDepth(0.0);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	glClearDepth(1.0);
+
+	graph_execute();
+	glReadPixels(0, 0, 1, 1, GL_DEPTH_COMPONENT, GL_FLOAT, &depth);
+	graph_destroy();
+
+	if (depth != 1.0f) {
+		fprintf(stderr, "Backbuffer depth is %g after the clear, not 1\n", depth);
+		return false;
+	}
+
+	return true;
+}
+
+static void
+run (int blurs)
+{
+	struct graph_timing timings[64];
+	struct graph_stats stats;
+
+	build(blurs);
+
+	// Warm up, and allocate:
+	for (int i = 0; i < 3; i++)
+		graph_execute();
+
+	glFinish();
+	double start = now();
+
+	for (int i = 0; i < opt.frames; i++)
+		graph_execute();
+
+	glFinish();
+	double wall = (now() - start) / opt.frames;
+
+	size_t n = graph_timings(timings, 64);
+	graph_stats(&stats);
+
+	printf("    { \"blurs\": %d, \"frame_ms\": %.3f, \"passes\": %zu, \"culled\": %zu"
+		", \"attachments\": %zu, \"physical\": %zu"
+		", \"transient_mib\": %.2f, \"unaliased_mib\": %.2f,\n      \"timings\": [",
+		blurs, wall * 1e3, stats.passes, stats.culled,
+		stats.attachments, stats.physical,
+		stats.transient_bytes / 1048576.0, stats.unaliased_bytes / 1048576.0);
+
+	for (size_t i = 0; i < n; i++)
+		printf("%s\n        { \"pass\": \"%s\", \"cpu_ms\": %.3f, \"gpu_ms\": %.3f }",
+			i ? "," : "", timings[i].name, timings[i].cpu_ms, timings[i].gpu_ms);
+
+	fputs(" ] }", stdout);
+
+	graph_destroy();
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "b:o:f:w:h:")) != -1) {
+		switch (c)
+		{
+		case 'b': opt.blurs   = atoi(optarg); break;
+		case 'o': opt.objects = atoi(optarg); break;
+		case 'f': opt.frames  = atoi(optarg); break;
+		case 'w': opt.width   = atoi(optarg); break;
+		case 'h': opt.height  = atoi(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-b blurs] [-o objects] [-f frames] [-w width] [-h height]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.blurs >= 0 && opt.objects > 0 && opt.frames > 0
+		&& opt.width > 0 && opt.height > 0;
+}
+
+// Run the frame as a render graph with a growing post-processing chain, and
+// report the cost of each pass and the transient memory, with and without
+// aliasing, as JSON on stdout:
+int
+main (int argc, char **argv)
+{
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (!headless_init(opt.width, opt.height))
+		return 1;
+
+	programs_init();
+	view_set_window(opt.width, opt.height);
+
+	model_set_objects(opt.objects, ANIMATE_GPU);
+	if (!model_init())
+		return 1;
+
+	if (!check_clear())
+		return 1;
+
+	printf("{\n  \"renderer\": \"%s\",\n  \"objects\": %zu,\n  \"frames\": %d,"
+		"\n  \"results\": [\n",
+		glGetString(GL_RENDERER), model_object_count(), opt.frames);
+
+	for (int blurs = 0; blurs <= opt.blurs; blurs = blurs ? blurs * 2 : 1) {
+		if (blurs > 0)
+			puts(",");
+
+		run(blurs);
+	}
+
+	puts("\n  ]\n}");
+
+	post_destroy();
+	headless_destroy();
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+
+#include "../debug.h"
+#include "headless.h"
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+static GLuint fbo, rbo[2];
+
+static EGLDisplay
+get_display (void)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)
+		eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	// Prefer a surfaceless display, so that no window system is needed:
+	if (get_platform_display != NULL) {
+		EGLDisplay d = get_platform_display
+			(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+		if (d != EGL_NO_DISPLAY)
+			return d;
+	}
+
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+// Create an offscreen OpenGL core context with a color and depth target of
+// the given size, and make it current:
+bool
+headless_init (int width, int height)
+{
+	EGLint major, minor;
+
+	EGLint attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION,		4,
+		EGL_CONTEXT_MINOR_VERSION,		5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,	EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifdef DEBUG
+		EGL_CONTEXT_OPENGL_DEBUG,		EGL_TRUE,
+#endif
+		EGL_NONE,
+	};
+
+	if ((display = get_display()) == EGL_NO_DISPLAY) {
+		fputs("Could not get EGL display\n", stderr);
+		return false;
+	}
+
+	if (!eglInitialize(display, &major, &minor)) {
+		fputs("Could not initialize EGL\n", stderr);
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		fputs("Could not bind OpenGL API\n", stderr);
+		return false;
+	}
+
+	// Contexts without a config need EGL_KHR_no_config_context:
+	context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+	if (context == EGL_NO_CONTEXT) {
+		fputs("Could not create OpenGL context\n", stderr);
+		return false;
+	}
+
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		fputs("Could not make context current\n", stderr);
+		return false;
+	}
+
+	DEBUG_INIT();
+
+	// Create framebuffer with color and depth attachments:
+	glGenFramebuffers(1, &fbo);
+	glGenRenderbuffers(2, rbo);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, rbo[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, rbo[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rbo[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, rbo[1]);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		fputs("Framebuffer incomplete\n", stderr);
+		return false;
+	}
+
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+void
+headless_destroy (void)
+{
+	if (context != EGL_NO_CONTEXT) {
+		glDeleteFramebuffers(1, &fbo);
+		glDeleteRenderbuffers(2, rbo);
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+		context = EGL_NO_CONTEXT;
+	}
+
+	if (display != EGL_NO_DISPLAY) {
+		eglTerminate(display);
+		display = EGL_NO_DISPLAY;
+	}
+}
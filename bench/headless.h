@@ -0,0 +1,4 @@
+#include <stdbool.h>
+
+bool headless_init (int width, int height);
+void headless_destroy (void);
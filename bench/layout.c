@@ -0,0 +1,315 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../extension.h"
+#include "../matrix.h"
+#include "../mesh.h"
+#include "../program.h"
+#include "../resource.h"
+#include "../util.h"
+#include "../vertex.h"
+#include "headless.h"
+
+// Define inline data:
+#define DATA_DEF(x)								\
+	extern const uint8_t _binary_bench_shaders_layout_## x ##_glsl_start[];	\
+	extern const uint8_t _binary_bench_shaders_layout_## x ##_glsl_end[];
+
+#define DATA(x)						\
+	_binary_bench_shaders_layout_## x ##_glsl_start,	\
+	_binary_bench_shaders_layout_## x ##_glsl_end
+
+DATA_DEF (attrib)
+DATA_DEF (pull)
+DATA_DEF (fragment)
+
+// Same data, each attribute padded to a 16-byte boundary:
+struct vertex_aligned {
+	struct point pos;	float pad0;
+	struct point normal;	float pad1;
+	struct color color;	float pad2;
+} __attribute__((aligned(16)));
+
+// The benchmark mesh, kept in packed form and converted per layout:
+static struct mesh mesh;
+
+// Per-layout GL state:
+static struct {
+	GLuint vao;
+	GLuint vbo[3];
+	GLuint program;
+} gl;
+
+// Command line options:
+static struct {
+	enum mesh_shape	shape;
+	int		triangles;
+	int		frames;
+	int		width;
+	int		height;
+} opt = {
+	.shape     = MESH_SPHERE,
+	.triangles = 1000000,
+	.frames    = 20,
+	.width     = 256,
+	.height    = 256,
+};
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+attrib (GLuint loc, GLsizei stride, size_t offset)
+{
+	glEnableVertexAttribArray(loc);
+	glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, stride, (void *) offset);
+}
+
+static size_t
+setup_aos_packed (void)
+{
+	size_t size = mesh.nvert * sizeof(struct vertex);
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl.vbo[0]);
+	glBufferData(GL_ARRAY_BUFFER, size, mesh.vert, GL_STATIC_DRAW);
+
+	attrib(0, sizeof(struct vertex), offsetof(struct vertex, pos));
+	attrib(1, sizeof(struct vertex), offsetof(struct vertex, normal));
+	attrib(2, sizeof(struct vertex), offsetof(struct vertex, color));
+
+	return size;
+}
+
+static size_t
+setup_aos_aligned (void)
+{
+	size_t size = mesh.nvert * sizeof(struct vertex_aligned);
+	struct vertex_aligned *buf = calloc(mesh.nvert, sizeof(*buf));
+
+	for (size_t i = 0; i < mesh.nvert; i++) {
+		buf[i].pos    = mesh.vert[i].pos;
+		buf[i].normal = mesh.vert[i].normal;
+		buf[i].color  = mesh.vert[i].color;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, gl.vbo[0]);
+	glBufferData(GL_ARRAY_BUFFER, size, buf, GL_STATIC_DRAW);
+	free(buf);
+
+	attrib(0, sizeof(struct vertex_aligned), offsetof(struct vertex_aligned, pos));
+	attrib(1, sizeof(struct vertex_aligned), offsetof(struct vertex_aligned, normal));
+	attrib(2, sizeof(struct vertex_aligned), offsetof(struct vertex_aligned, color));
+
+	return size;
+}
+
+static size_t
+setup_soa (void)
+{
+	size_t size = mesh.nvert * sizeof(struct point);
+	struct point *buf = malloc(size);
+
+	size_t offset[3] = {
+		offsetof(struct vertex, pos),
+		offsetof(struct vertex, normal),
+		offsetof(struct vertex, color),
+	};
+
+	// One tightly packed stream per attribute:
+	for (int a = 0; a < 3; a++) {
+		for (size_t i = 0; i < mesh.nvert; i++)
+			memcpy(&buf[i], (char *) &mesh.vert[i] + offset[a], sizeof(*buf));
+
+		glBindBuffer(GL_ARRAY_BUFFER, gl.vbo[a]);
+		glBufferData(GL_ARRAY_BUFFER, size, buf, GL_STATIC_DRAW);
+		attrib(a, sizeof(struct point), 0);
+	}
+
+	free(buf);
+	return size * 3;
+}
+
+static size_t
+setup_pull (void)
+{
+	size_t size = mesh.nvert * sizeof(struct vertex);
+
+	// No attributes; the shader indexes the buffer by gl_VertexID:
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl.vbo[0]);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, mesh.vert, GL_STATIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, gl.vbo[0]);
+
+	return size;
+}
+
+static const struct layout {
+	const char	 *name;
+	size_t		(*setup) (void);
+	size_t		  stride;
+	const uint8_t	 *vert;
+	const uint8_t	 *vert_end;
+	int		  glsl;
+}
+layouts[] = {
+	{ "aos_packed",  setup_aos_packed,  sizeof(struct vertex),         DATA (attrib), 330 },
+	{ "aos_aligned", setup_aos_aligned, sizeof(struct vertex_aligned), DATA (attrib), 330 },
+	{ "soa",         setup_soa,         sizeof(struct point),          DATA (attrib), 330 },
+	{ "pull",        setup_pull,        sizeof(struct vertex),         DATA (pull),   430 },
+};
+
+static void
+run_layout (const struct layout *l, bool first)
+{
+	float view[16], frustum[16], translate[16], model[16];
+	GLuint query[opt.frames];
+	GLuint64 gpu_ns = 0;
+
+	if (!first)
+		puts(",");
+
+	if (!extension_version(l->glsl)) {
+		printf("    { \"layout\": \"%s\", \"supported\": false }", l->name);
+		return;
+	}
+
+	glGenVertexArrays(1, &gl.vao);
+	glGenBuffers(NELEM(gl.vbo), gl.vbo);
+	glBindVertexArray(gl.vao);
+
+	gl.program = program_create
+		("layout", l->vert, l->vert_end, DATA (fragment));
+
+	// Time the upload including the driver's copy:
+	double t0 = now();
+	size_t bytes = l->setup();
+	glFinish();
+	double upload = now() - t0;
+
+	mat_frustum(frustum, 0.7, (float) opt.width / opt.height, 0.5, 6);
+	mat_translate(translate, 0, 0, 2);
+	mat_multiply(view, frustum, translate);
+
+	glUseProgram(gl.program);
+	glUniformMatrix4fv(glGetUniformLocation(gl.program, "view_matrix"), 1, GL_FALSE, view);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	// Warm up, so shader and buffer residency costs are excluded:
+	for (int i = 0; i < 3; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDrawArrays(GL_TRIANGLES, 0, mesh.nvert);
+	}
+	glFinish();
+
+	glGenQueries(opt.frames, query);
+	t0 = now();
+
+	for (int i = 0; i < opt.frames; i++) {
+		mat_rotate(model, 0, 1, 0, i * 0.01f);
+		glUniformMatrix4fv(glGetUniformLocation(gl.program, "model_matrix"), 1, GL_FALSE, model);
+
+		glBeginQuery(GL_TIME_ELAPSED, query[i]);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glDrawArrays(GL_TRIANGLES, 0, mesh.nvert);
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+
+	glFinish();
+	double wall = (now() - t0) / opt.frames;
+
+	for (int i = 0; i < opt.frames; i++) {
+		GLuint64 ns;
+		glGetQueryObjectui64v(query[i], GL_QUERY_RESULT, &ns);
+		gpu_ns += ns;
+	}
+
+	double gpu = gpu_ns * 1e-9 / opt.frames;
+
+	printf("    { \"layout\": \"%s\", \"supported\": true"
+		", \"stride\": %zu, \"bytes\": %zu, \"upload_ms\": %.3f"
+		", \"frame_ms\": %.3f, \"gpu_ms\": %.3f, \"mverts_per_sec\": %.2f }",
+		l->name, l->stride, bytes, upload * 1e3,
+		wall * 1e3, gpu * 1e3, mesh.nvert / wall * 1e-6);
+
+	glDeleteQueries(opt.frames, query);
+	resource_delete(RESOURCE_PROGRAM, gl.program);
+	glDeleteBuffers(NELEM(gl.vbo), gl.vbo);
+	glDeleteVertexArrays(1, &gl.vao);
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "s:t:f:w:h:")) != -1) {
+		switch (c)
+		{
+		case 's':
+			if (!mesh_shape_parse(optarg, &opt.shape)) {
+				fprintf(stderr, "Unknown shape: %s\n", optarg);
+				return false;
+			}
+			break;
+
+		case 't': opt.triangles = atoi(optarg); break;
+		case 'f': opt.frames    = atoi(optarg); break;
+		case 'w': opt.width     = atoi(optarg); break;
+		case 'h': opt.height    = atoi(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-s cube|sphere|grid] [-t triangles] [-f frames] [-w width] [-h height]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.triangles > 0 && opt.frames > 0 && opt.width > 0 && opt.height > 0;
+}
+
+// Render the same mesh in each vertex layout and report the throughput
+// of each as JSON on stdout:
+int
+main (int argc, char **argv)
+{
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (!headless_init(opt.width, opt.height))
+		return 1;
+
+	if (!mesh_generate(&mesh, opt.shape, opt.triangles, 0))
+		return 1;
+
+	printf("{\n  \"renderer\": \"%s\",\n  \"version\": \"%s\",\n"
+		"  \"shape\": \"%s\",\n  \"triangles\": %zu,\n"
+		"  \"generate_ms\": %.3f,\n  \"generate_threads\": %d,\n"
+		"  \"frames\": %d,\n  \"results\": [\n",
+		glGetString(GL_RENDERER), glGetString(GL_VERSION),
+		mesh_shape_name(mesh.shape), mesh.nvert / 3,
+		mesh.seconds * 1e3, mesh.threads, opt.frames);
+
+	FOREACH (layouts, l)
+		run_layout(l, l == layouts);
+
+	puts("\n  ]\n}");
+
+	mesh_free(&mesh);
+	headless_destroy();
+	return 0;
+}
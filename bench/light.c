@@ -0,0 +1,141 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../model.h"
+#include "../program.h"
+#include "../view.h"
+#include "headless.h"
+
+// Command line options:
+static struct {
+	int	lights;
+	int	objects;
+	int	frames;
+	int	width;
+	int	height;
+} opt = {
+	.lights  = 1024,
+	.objects = 1000,
+	.frames  = 20,
+	.width   = 512,
+	.height  = 512,
+};
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Draw frames lit by the given number of lights, either shading every
+// fragment with every light or only with the lights of its cluster:
+static void
+run (int lights, bool clustered)
+{
+	struct light_stats before, after;
+
+	model_set_lights(lights);
+	model_set_objects(opt.objects, ANIMATE_GPU);
+	light_set_clustered(clustered);
+
+	// Warm up:
+	for (int i = 0; i < 3; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		model_draw();
+	}
+	glFinish();
+
+	light_stats(&before);
+	double start = now();
+
+	for (int i = 0; i < opt.frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		model_draw();
+	}
+
+	glFinish();
+	double wall = (now() - start) / opt.frames;
+
+	light_stats(&after);
+
+	printf("    { \"lights\": %zu, \"mode\": \"%s\", \"frame_ms\": %.3f"
+		", \"bin_ms\": %.3f, \"indices\": %zu, \"max_cluster\": %zu }",
+		light_count(), clustered ? "clustered" : "all", wall * 1e3,
+		(after.bin_seconds - before.bin_seconds) * 1e3 / opt.frames,
+		after.indices, after.max_cluster);
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:o:f:w:h:")) != -1) {
+		switch (c)
+		{
+		case 'n': opt.lights  = atoi(optarg); break;
+		case 'o': opt.objects = atoi(optarg); break;
+		case 'f': opt.frames  = atoi(optarg); break;
+		case 'w': opt.width   = atoi(optarg); break;
+		case 'h': opt.height  = atoi(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n lights] [-o objects] [-f frames] [-w width] [-h height]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.lights > 0 && opt.objects > 0 && opt.frames > 0
+		&& opt.width > 0 && opt.height > 0;
+}
+
+// Light a scene of objects with a growing number of point lights, shading
+// with all lights and with the lights binned per cluster, and report the
+// frame time, binning time and light list sizes of each as JSON on stdout:
+int
+main (int argc, char **argv)
+{
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (!headless_init(opt.width, opt.height))
+		return 1;
+
+	programs_init();
+	view_set_window(opt.width, opt.height);
+
+	if (!program_light_available()) {
+		fputs("Lighting needs OpenGL 4.3\n", stderr);
+		return 1;
+	}
+
+	if (!model_init())
+		return 1;
+
+	printf("{\n  \"renderer\": \"%s\",\n  \"objects\": %d,\n  \"frames\": %d,"
+		"\n  \"results\": [\n",
+		glGetString(GL_RENDERER), opt.objects, opt.frames);
+
+	for (int lights = 16; lights <= opt.lights; lights *= 4) {
+		if (lights > 16)
+			puts(",");
+
+		run(lights, false);
+		puts(",");
+		run(lights, true);
+	}
+
+	puts("\n  ]\n}");
+
+	headless_destroy();
+	return 0;
+}
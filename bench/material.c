@@ -0,0 +1,139 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../model.h"
+#include "../program.h"
+#include "../stats.h"
+#include "../view.h"
+#include "headless.h"
+
+// Command line options:
+static struct {
+	int	objects;
+	int	materials;
+	int	frames;
+	int	width;
+	int	height;
+} opt = {
+	.objects   = 10000,
+	.materials = 16,
+	.frames    = 50,
+	.width     = 512,
+	.height    = 512,
+};
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+run (enum material_mode mode)
+{
+	size_t counts[STAT_COUNT];
+
+	model_set_materials(opt.materials, mode);
+	model_set_objects(opt.objects, ANIMATE_GPU);
+
+	// Warm up:
+	for (int i = 0; i < 3; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		model_draw();
+	}
+	glFinish();
+
+	stats_reset();
+	double start = now();
+
+	for (int i = 0; i < opt.frames; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		model_draw();
+	}
+
+	glFinish();
+	double wall = (now() - start) / opt.frames;
+
+	stats_get(counts);
+
+	printf("    { \"mode\": \"%s\", \"frame_ms\": %.3f",
+		material_mode_name(mode), wall * 1e3);
+
+	for (int i = 0; i < STAT_COUNT; i++)
+		printf(", \"%s\": %zu", stats_name(i), counts[i] / opt.frames);
+
+	fputs(" }", stdout);
+
+	model_set_objects(0, ANIMATE_GPU);
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:m:f:w:h:")) != -1) {
+		switch (c)
+		{
+		case 'n': opt.objects   = atoi(optarg); break;
+		case 'm': opt.materials = atoi(optarg); break;
+		case 'f': opt.frames    = atoi(optarg); break;
+		case 'w': opt.width     = atoi(optarg); break;
+		case 'h': opt.height    = atoi(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n objects] [-m materials] [-f frames] [-w width] [-h height]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.objects > 0 && opt.materials > 0 && opt.frames > 0
+		&& opt.width > 0 && opt.height > 0;
+}
+
+// Draw a scene of objects with mixed materials, once binding each object's
+// own texture and once from a texture array, and report the draw calls and
+// state changes per frame of each as JSON on stdout:
+int
+main (int argc, char **argv)
+{
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (!headless_init(opt.width, opt.height))
+		return 1;
+
+	programs_init();
+	view_set_window(opt.width, opt.height);
+
+	if (!program_cube_mat_available()) {
+		fputs("Materials need OpenGL 4.3\n", stderr);
+		return 1;
+	}
+
+	if (!model_init())
+		return 1;
+
+	printf("{\n  \"renderer\": \"%s\",\n  \"objects\": %d,\n  \"materials\": %d,"
+		"\n  \"frames\": %d,\n  \"results\": [\n",
+		glGetString(GL_RENDERER), opt.objects, opt.materials, opt.frames);
+
+	run(MATERIAL_SEPARATE);
+	puts(",");
+	run(MATERIAL_ARRAY);
+
+	puts("\n  ]\n}");
+
+	headless_destroy();
+	return 0;
+}
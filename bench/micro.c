@@ -0,0 +1,333 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../matrix.h"
+#include "../model.h"
+#include "../program.h"
+#include "../util.h"
+#include "../view.h"
+#include "headless.h"
+
+// Size of the offscreen frame:
+#define WIDTH	256
+#define HEIGHT	256
+
+// Command line options:
+static struct {
+	int		 repeats;
+	int		 warmup;
+	double		 threshold;
+	const char	*output;
+	const char	*baseline;
+} opt = {
+	.repeats   = 31,
+	.warmup    = 5,
+	.threshold = 10.0,
+};
+
+// Timing of one benchmark, in nanoseconds per call:
+struct result {
+	char	name[64];
+	double	median;
+	double	mad;
+	double	min;
+};
+
+// A benchmark calls the function under test n times per sample:
+struct bench {
+	const char	*name;
+	int		 batch;
+	void		(*run) (int n);
+};
+
+static float a[16], b[16], m[16];
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+run_frustum (int n)
+{
+	for (int i = 0; i < n; i++)
+		mat_frustum(m, 45.0f + i % 8, 1.5f, 0.5f, 10.0f);
+}
+
+static void
+run_translate (int n)
+{
+	for (int i = 0; i < n; i++)
+		mat_translate(m, i % 8, 1.0f, -2.0f);
+}
+
+static void
+run_rotate (int n)
+{
+	for (int i = 0; i < n; i++)
+		mat_rotate(m, 0.3f, 1.0f, 0.2f, i * 0.01f);
+}
+
+static void
+run_multiply (int n)
+{
+	for (int i = 0; i < n; i++)
+		mat_multiply(m, a, b);
+}
+
+// Mesh construction as done by model_init(), for the default cube and for
+// a large sphere:
+static void
+run_mesh (enum mesh_shape shape, size_t triangles, int n)
+{
+	struct mesh mesh;
+
+	for (int i = 0; i < n; i++) {
+		mesh_generate(&mesh, shape, triangles, 0);
+		mesh_free(&mesh);
+	}
+}
+
+static void
+run_mesh_cube (int n)
+{
+	run_mesh(MESH_CUBE, 12, n);
+}
+
+static void
+run_mesh_sphere (int n)
+{
+	run_mesh(MESH_SPHERE, 100000, n);
+}
+
+// Compile and link all programs, waiting for the driver to finish:
+static void
+run_programs (int n)
+{
+	for (int i = 0; i < n; i++) {
+		programs_destroy();
+		programs_init();
+		glFinish();
+	}
+}
+
+// Render and finish whole frames of the default scene:
+static void
+run_frame (int n)
+{
+	for (int i = 0; i < n; i++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		model_draw();
+		glFinish();
+	}
+}
+
+static struct bench benches[] = {
+	{ "mat_frustum",	10000,	run_frustum	},
+	{ "mat_translate",	10000,	run_translate	},
+	{ "mat_rotate",		10000,	run_rotate	},
+	{ "mat_multiply",	10000,	run_multiply	},
+	{ "mesh_cube",		1000,	run_mesh_cube	},
+	{ "mesh_sphere_100k",	1,	run_mesh_sphere	},
+	{ "programs_init",	1,	run_programs	},
+	{ "frame",		10,	run_frame	},
+};
+
+static int
+compare (const void *p, const void *q)
+{
+	double x = *(const double *) p;
+	double y = *(const double *) q;
+
+	return (x > y) - (x < y);
+}
+
+// Median of a sorted array:
+static double
+median (const double *v, int n)
+{
+	return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// Time a benchmark after some warmup samples, and summarize the samples
+// by their median and median absolute deviation, which unlike mean and
+// standard deviation are not thrown off by the odd preempted sample:
+static void
+measure (const struct bench *bench, struct result *result)
+{
+	double t[opt.repeats], dev[opt.repeats];
+
+	for (int i = 0; i < opt.warmup; i++)
+		bench->run(bench->batch);
+
+	for (int i = 0; i < opt.repeats; i++) {
+		double start = now();
+		bench->run(bench->batch);
+		t[i] = (now() - start) * 1e9 / bench->batch;
+	}
+
+	qsort(t, opt.repeats, sizeof(double), compare);
+
+	snprintf(result->name, sizeof(result->name), "%s", bench->name);
+	result->median = median(t, opt.repeats);
+	result->min    = t[0];
+
+	for (int i = 0; i < opt.repeats; i++)
+		dev[i] = fabs(t[i] - result->median);
+
+	qsort(dev, opt.repeats, sizeof(double), compare);
+	result->mad = median(dev, opt.repeats);
+}
+
+// Read the results from a file written by this program. Each result is on
+// its own line, so there is no need for a full JSON parser:
+static int
+read_baseline (const char *path, struct result *base, int max)
+{
+	FILE *f = fopen(path, "r");
+	char line[256];
+	int n = 0;
+
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	while (n < max && fgets(line, sizeof(line), f) != NULL) {
+		struct result *r = &base[n];
+
+		if (sscanf(line, " { \"name\": \"%63[^\"]\", \"median_ns\": %lf, \"mad_ns\": %lf, \"min_ns\": %lf",
+				r->name, &r->median, &r->mad, &r->min) == 4)
+			n++;
+	}
+
+	fclose(f);
+	return n;
+}
+
+static const struct result *
+find_result (const struct result *r, int n, const char *name)
+{
+	for (int i = 0; i < n; i++)
+		if (strcmp(r[i].name, name) == 0)
+			return &r[i];
+
+	return NULL;
+}
+
+// A regression is a slowdown beyond the threshold that is also well outside
+// the noise of both runs:
+static bool
+regressed (const struct result *r, const struct result *base, double *change)
+{
+	*change = (r->median / base->median - 1) * 100;
+
+	return *change > opt.threshold
+	    && r->median - base->median > 3 * (r->mad + base->mad);
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:k:o:c:t:")) != -1) {
+		switch (c)
+		{
+		case 'n': opt.repeats   = atoi(optarg); break;
+		case 'k': opt.warmup    = atoi(optarg); break;
+		case 'o': opt.output    = optarg;       break;
+		case 'c': opt.baseline  = optarg;       break;
+		case 't': opt.threshold = atof(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n repeats] [-k warmup] [-o output] [-c baseline] [-t threshold]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.repeats > 0 && opt.warmup >= 0 && opt.threshold >= 0;
+}
+
+// Run all microbenchmarks and write their timings as JSON, to stdout or to
+// the output file. With a baseline from an earlier run, report the change
+// of each, and exit with status 2 if any regressed:
+int
+main (int argc, char **argv)
+{
+	struct result results[NELEM(benches)];
+	struct result base[NELEM(benches)];
+	int nbase = 0, regressions = 0;
+	FILE *out = stdout;
+
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (opt.baseline && (nbase = read_baseline(opt.baseline, base, NELEM(base))) < 0)
+		return 1;
+
+	if (!headless_init(WIDTH, HEIGHT))
+		return 1;
+
+	programs_init();
+	view_set_window(WIDTH, HEIGHT);
+	if (!model_init())
+		return 1;
+
+	mat_rotate(a, 1.0f, 0.0f, 0.0f, 0.5f);
+	mat_rotate(b, 0.0f, 1.0f, 0.0f, 0.5f);
+
+	for (size_t i = 0; i < NELEM(benches); i++)
+		measure(&benches[i], &results[i]);
+
+	if (opt.output && (out = fopen(opt.output, "w")) == NULL) {
+		perror(opt.output);
+		return 1;
+	}
+
+	fprintf(out, "{\n  \"renderer\": \"%s\",\n  \"repeats\": %d,\n  \"warmup\": %d,\n  \"results\": [\n",
+		glGetString(GL_RENDERER), opt.repeats, opt.warmup);
+
+	for (size_t i = 0; i < NELEM(results); i++) {
+		const struct result *r = &results[i];
+		const struct result *b = find_result(base, nbase, r->name);
+
+		fprintf(out, "    { \"name\": \"%s\", \"median_ns\": %.1f, \"mad_ns\": %.1f, \"min_ns\": %.1f",
+			r->name, r->median, r->mad, r->min);
+
+		if (b != NULL) {
+			double change;
+			bool bad = regressed(r, b, &change);
+
+			fprintf(out, ", \"baseline_ns\": %.1f, \"change_pct\": %.1f, \"regression\": %s",
+				b->median, change, bad ? "true" : "false");
+
+			if (bad) {
+				fprintf(stderr, "Regression: %s is %.1f%% slower than the baseline\n", r->name, change);
+				regressions++;
+			}
+		}
+
+		fprintf(out, " }%s\n", i + 1 < NELEM(results) ? "," : "");
+	}
+
+	fputs("  ]\n}\n", out);
+
+	if (out != stdout)
+		fclose(out);
+
+	headless_destroy();
+	return regressions ? 2 : 0;
+}
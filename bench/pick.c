@@ -0,0 +1,151 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <GL/gl.h>
+
+#include "../model.h"
+#include "../pick.h"
+#include "../program.h"
+#include "../view.h"
+#include "headless.h"
+
+// Command line options:
+static struct {
+	int	objects;
+	int	picks;
+	int	width;
+	int	height;
+} opt = {
+	.objects = 100000,
+	.picks   = 100,
+	.width   = 512,
+	.height  = 512,
+};
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Render frames until each pick returns, and record the results:
+static void
+run (enum pick_backend backend, int *objects)
+{
+	double pick_time = 0, frame_time = 0;
+	unsigned latency = 0, max_latency = 0, frames = 0, hits = 0;
+
+	pick_init(backend);
+	srand(1);
+
+	for (int i = 0; i < opt.picks; i++) {
+		struct pick pick;
+
+		pick_request(rand() % opt.width, rand() % opt.height);
+
+		for (;;) {
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			model_draw();
+
+			// Keep the frame's own work out of the measurement:
+			glFinish();
+
+			double start = now();
+			bool done = pick_frame(&pick);
+			pick_time += now() - start;
+
+			// Include the GPU work of the pick:
+			glFinish();
+			frame_time += now() - start;
+			frames++;
+
+			if (done)
+				break;
+		}
+
+		objects[i] = pick.object;
+		latency += pick.latency;
+		hits += pick.object >= 0;
+
+		if (pick.latency > max_latency)
+			max_latency = pick.latency;
+	}
+
+	printf("    { \"backend\": \"%s\", \"picks\": %d, \"hits\": %u"
+		", \"pick_cpu_us\": %.2f, \"pick_gpu_us\": %.2f"
+		", \"latency_frames\": %.2f, \"max_latency_frames\": %u }",
+		pick_backend_name(backend), opt.picks, hits,
+		pick_time * 1e6 / frames, frame_time * 1e6 / frames,
+		(double) latency / opt.picks, max_latency);
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "n:p:w:h:")) != -1) {
+		switch (c)
+		{
+		case 'n': opt.objects = atoi(optarg); break;
+		case 'p': opt.picks   = atoi(optarg); break;
+		case 'w': opt.width   = atoi(optarg); break;
+		case 'h': opt.height  = atoi(optarg); break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-n objects] [-p picks] [-w width] [-h height]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.objects > 0 && opt.picks > 0 && opt.width > 0 && opt.height > 0;
+}
+
+// Pick random points with both backends and report the cost, the latency
+// in frames, and how often the backends agree, as JSON on stdout:
+int
+main (int argc, char **argv)
+{
+	if (!parse_options(argc, argv))
+		return 1;
+
+	if (!headless_init(opt.width, opt.height))
+		return 1;
+
+	programs_init();
+	view_set_window(opt.width, opt.height);
+
+	model_set_objects(opt.objects, ANIMATE_GPU);
+	if (!model_init())
+		return 1;
+
+	int *cpu = calloc(opt.picks, sizeof(int));
+	int *gpu = calloc(opt.picks, sizeof(int));
+	int agree = 0;
+
+	printf("{\n  \"renderer\": \"%s\",\n  \"objects\": %zu,\n  \"results\": [\n",
+		glGetString(GL_RENDERER), model_object_count());
+
+	run(PICK_CPU, cpu);
+	puts(",");
+	run(PICK_GPU, gpu);
+
+	// The CPU backend tests bounding spheres, so it may also report
+	// objects near, rather than under, the cursor:
+	for (int i = 0; i < opt.picks; i++)
+		agree += cpu[i] == gpu[i];
+
+	printf("\n  ],\n  \"agree\": %d\n}\n", agree);
+
+	free(cpu);
+	free(gpu);
+	headless_destroy();
+	return 0;
+}
@@ -0,0 +1,272 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <X11/Xlib.h>
+#include <GL/gl.h>
+
+#include "../graph.h"
+#include "../model.h"
+#include "../post.h"
+#include "../present.h"
+#include "../program.h"
+#include "../resource.h"
+#include "../util.h"
+#include "../view.h"
+
+// Command line options:
+static struct {
+	int	objects;
+	int	frames;
+	int	interval;
+	bool	pbuffer;
+} opt = {
+	.objects  = 1000,
+	.frames   = 30,
+	.interval = 0,
+	.pbuffer  = false,
+};
+
+static const struct {
+	const char	*name;
+	int		 width;
+	int		 height;
+}
+sizes[] = {
+	{ "1080p", 1920, 1080 },
+	{ "4k",    3840, 2160 },
+};
+
+// Offscreen framebuffer that stands in for the GtkGLArea's own:
+static struct {
+	GLuint	fbo;
+	GLuint	rbo[2];
+} area;
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+area_init (int width, int height)
+{
+	area.fbo    = resource_create(RESOURCE_FRAMEBUFFER,  "present");
+	area.rbo[0] = resource_create(RESOURCE_RENDERBUFFER, "present");
+	area.rbo[1] = resource_create(RESOURCE_RENDERBUFFER, "present");
+
+	glBindRenderbuffer(GL_RENDERBUFFER, area.rbo[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, area.rbo[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, area.fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, area.rbo[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, area.rbo[1]);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static void
+area_destroy (void)
+{
+	resource_delete(RESOURCE_FRAMEBUFFER,  area.fbo);
+	resource_delete(RESOURCE_RENDERBUFFER, area.rbo[0]);
+	resource_delete(RESOURCE_RENDERBUFFER, area.rbo[1]);
+}
+
+// Render one frame and present it. Through the area, the frame is drawn
+// offscreen and then copied to the surface, as GDK does with the
+// GtkGLArea's framebuffer; directly, it is drawn into the surface:
+static void
+frame (enum present_backend backend, int width, int height)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, backend == PRESENT_AREA ? area.fbo : 0);
+	graph_execute();
+
+	if (backend == PRESENT_AREA) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, area.fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+
+	present_swap();
+}
+
+// Time frames back to back, and the latency of single frames from the
+// start of rendering until the GPU has finished presenting them:
+static void
+run (enum present_backend backend, int width, int height)
+{
+	double latency = 0, max_latency = 0;
+
+	for (int i = 0; i < 3; i++)
+		frame(backend, width, height);
+
+	glFinish();
+	double start = now();
+
+	for (int i = 0; i < opt.frames; i++)
+		frame(backend, width, height);
+
+	glFinish();
+	double wall = (now() - start) / opt.frames;
+
+	for (int i = 0; i < opt.frames; i++) {
+		double t = now();
+
+		frame(backend, width, height);
+
+		// Fence the commands after the swap, which includes its copy:
+		GLsync sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		glDeleteSync(sync);
+
+		t = now() - t;
+		latency += t;
+
+		if (t > max_latency)
+			max_latency = t;
+	}
+
+	printf("      { \"backend\": \"%s\", \"frame_ms\": %.3f, \"latency_ms\": %.3f, \"max_latency_ms\": %.3f }",
+		present_backend_name(backend), wall * 1e3,
+		latency * 1e3 / opt.frames, max_latency * 1e3);
+}
+
+// Map a window of the given size and wait until it is shown:
+static Window
+create_window (Display *display, int width, int height)
+{
+	XEvent event;
+	Window window = XCreateSimpleWindow(display, DefaultRootWindow(display),
+		0, 0, width, height, 0, 0, 0);
+
+	XSelectInput(display, window, StructureNotifyMask);
+	XMapWindow(display, window);
+
+	do
+		XNextEvent(display, &event);
+	while (event.type != MapNotify);
+
+	return window;
+}
+
+static bool
+run_size (Display *display, int index)
+{
+	int width  = sizes[index].width;
+	int height = sizes[index].height;
+	Window window = display ? create_window(display, width, height) : 0;
+
+	if (!present_init(display, window, width, height, opt.interval))
+		return false;
+
+	programs_init();
+	view_set_window(width, height);
+
+	model_set_objects(opt.objects, ANIMATE_GPU);
+	if (!model_init())
+		return false;
+
+	// The only pass is the model, which tests depth as in the GUI:
+	glEnable(GL_DEPTH_TEST);
+
+	graph_add(&(struct graph_pass) {
+		.name  = "model",
+		.run   = model_draw,
+		.clear = { GRAPH_BACKBUFFER, GRAPH_BACKBUFFER_DEPTH },
+	});
+
+	graph_set_window(width, height);
+	graph_compile();
+	area_init(width, height);
+
+	printf("%s    { \"size\": \"%s\", \"width\": %d, \"height\": %d, \"renderer\": \"%s\", \"results\": [\n",
+		index ? ",\n" : "", sizes[index].name, width, height, glGetString(GL_RENDERER));
+
+	run(PRESENT_AREA, width, height);
+	puts(",");
+	run(PRESENT_EGL, width, height);
+	fputs("\n    ] }", stdout);
+
+	area_destroy();
+	graph_destroy();
+	post_destroy();
+	model_destroy();
+	programs_destroy();
+	present_destroy();
+
+	if (display != NULL)
+		XDestroyWindow(display, window);
+
+	return true;
+}
+
+static bool
+parse_options (int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "o:f:i:p")) != -1) {
+		switch (c)
+		{
+		case 'o': opt.objects  = atoi(optarg); break;
+		case 'f': opt.frames   = atoi(optarg); break;
+		case 'i': opt.interval = atoi(optarg); break;
+		case 'p': opt.pbuffer  = true;         break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-o objects] [-f frames] [-i swap interval] [-p]\n", argv[0]);
+			return false;
+		}
+	}
+
+	return opt.objects > 0 && opt.frames > 0 && opt.interval >= 0;
+}
+
+// Compare presenting through an offscreen framebuffer, as the GtkGLArea
+// does, with rendering straight into an EGL window surface, at 1080p and
+// 4K, and report frame time and latency as JSON on stdout. Needs a window
+// on $DISPLAY, e.g. under xvfb-run. With -p, a pbuffer stands in for the
+// window; swapping a pbuffer does nothing, so that only checks that the
+// paths run, and its numbers say nothing about presentation:
+int
+main (int argc, char **argv)
+{
+	if (!parse_options(argc, argv))
+		return 1;
+
+	Display *display = NULL;
+
+	if (!opt.pbuffer && (display = XOpenDisplay(NULL)) == NULL) {
+		fputs("Could not open the X display; run under xvfb-run, or use -p\n", stderr);
+		return 1;
+	}
+
+	if (opt.pbuffer)
+		fputs("Presenting to a pbuffer: swaps do nothing, timings are not comparable\n", stderr);
+
+	printf("{\n  \"surface\": \"%s\",\n  \"objects\": %d,\n  \"frames\": %d,"
+		"\n  \"swap_interval\": %d,\n  \"sizes\": [\n",
+		display ? "window" : "pbuffer", opt.objects, opt.frames, opt.interval);
+
+	for (size_t i = 0; i < NELEM(sizes); i++)
+		if (!run_size(display, i))
+			return 1;
+
+	puts("\n  ]\n}");
+
+	if (display != NULL)
+		XCloseDisplay(display);
+
+	return 0;
+}
@@ -0,0 +1,19 @@
+#version 330
+
+uniform mat4 view_matrix;
+uniform mat4 model_matrix;
+
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec3 vcolor;
+
+out vec3 fcolor;
+
+void main (void)
+{
+	gl_Position = view_matrix * model_matrix * vec4(vertex, 1.0);
+
+	/* Shade by the angle between sight and normal: */
+	vec4 wnormal = model_matrix * vec4(normal, 0.0);
+	fcolor = vcolor * max(-wnormal.z, 0.2);
+}
@@ -0,0 +1,10 @@
+#version 330
+
+in vec3 fcolor;
+
+out vec4 fragcolor;
+
+void main (void)
+{
+	fragcolor = vec4(fcolor, 1.0);
+}
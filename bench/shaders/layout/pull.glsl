@@ -0,0 +1,30 @@
+#version 430
+
+uniform mat4 view_matrix;
+uniform mat4 model_matrix;
+
+/* Packed vertices of nine floats each: position, normal, color: */
+layout (std430, binding = 0) readonly buffer Vertices {
+	float data[];
+};
+
+out vec3 fcolor;
+
+vec3 fetch (int offset)
+{
+	int i = gl_VertexID * 9 + offset;
+	return vec3(data[i], data[i + 1], data[i + 2]);
+}
+
+void main (void)
+{
+	vec3 vertex = fetch(0);
+	vec3 normal = fetch(3);
+	vec3 vcolor = fetch(6);
+
+	gl_Position = view_matrix * model_matrix * vec4(vertex, 1.0);
+
+	/* Shade by the angle between sight and normal: */
+	vec4 wnormal = model_matrix * vec4(normal, 0.0);
+	fcolor = vcolor * max(-wnormal.z, 0.2);
+}
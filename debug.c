@@ -0,0 +1,350 @@
+#ifdef DEBUG
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <GL/gl.h>
+
+#include "debug.h"
+#include "extension.h"
+#include "util.h"
+
+// Application messages, sent through the same callback as the driver's:
+enum {
+	MSG_SOFTWARE = 1,
+	MSG_REDUNDANT_UPLOAD,
+};
+
+#define MAX_GROUPS	64
+#define MAX_UPLOADS	256
+
+// Last contents uploaded to a buffer range:
+struct upload {
+	GLuint		buffer;
+	size_t		offset;
+	size_t		size;
+	uint64_t	hash;
+};
+
+static struct {
+	bool		 enabled;
+	const char	*groups[MAX_GROUPS];
+	int		 depth;
+	size_t		 counts[8];
+	struct upload	 uploads[MAX_UPLOADS];
+	size_t		 nuploads;
+	size_t		 next_upload;
+} state;
+
+struct name {
+	GLenum		 value;
+	const char	*name;
+};
+
+static const struct name sources[] = {
+	{ GL_DEBUG_SOURCE_API,			"api"			},
+	{ GL_DEBUG_SOURCE_WINDOW_SYSTEM,	"window system"		},
+	{ GL_DEBUG_SOURCE_SHADER_COMPILER,	"shader compiler"	},
+	{ GL_DEBUG_SOURCE_THIRD_PARTY,		"third party"		},
+	{ GL_DEBUG_SOURCE_APPLICATION,		"application"		},
+	{ GL_DEBUG_SOURCE_OTHER,		"other"			},
+};
+
+static const struct name types[] = {
+	{ GL_DEBUG_TYPE_ERROR,			"error"			},
+	{ GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR,	"deprecated"		},
+	{ GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR,	"undefined"		},
+	{ GL_DEBUG_TYPE_PORTABILITY,		"portability"		},
+	{ GL_DEBUG_TYPE_PERFORMANCE,		"performance"		},
+	{ GL_DEBUG_TYPE_MARKER,			"marker"		},
+	{ GL_DEBUG_TYPE_OTHER,			"other"			},
+};
+
+static const struct name severities[] = {
+	{ GL_DEBUG_SEVERITY_HIGH,		"high"			},
+	{ GL_DEBUG_SEVERITY_MEDIUM,		"medium"		},
+	{ GL_DEBUG_SEVERITY_LOW,		"low"			},
+	{ GL_DEBUG_SEVERITY_NOTIFICATION,	"notification"		},
+};
+
+#define LOOKUP(table, v) lookup(table, NELEM(table), v)
+
+static int
+lookup_index (const struct name *table, size_t n, GLenum value)
+{
+	for (size_t i = 0; i < n; i++)
+		if (table[i].value == value)
+			return i;
+
+	return -1;
+}
+
+static const char *
+lookup (const struct name *table, size_t n, GLenum value)
+{
+	int i = lookup_index(table, n, value);
+
+	return i < 0 ? "unknown" : table[i].name;
+}
+
+// Write a string as a JSON string:
+static void
+print_string (const char *s, GLsizei length)
+{
+	putc('"', stderr);
+
+	for (GLsizei i = 0; length < 0 ? s[i] != '\0' : i < length; i++) {
+		unsigned char c = s[i];
+
+		if (c == '"' || c == '\\')
+			fprintf(stderr, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(stderr, "\\u%04x", c);
+		else
+			putc(c, stderr);
+	}
+
+	putc('"', stderr);
+}
+
+// Log each message as one line of JSON on stderr, with the debug group it
+// was raised in:
+static void APIENTRY
+callback (GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar *message, const void *user)
+{
+	(void) user;
+
+	int t = lookup_index(types, NELEM(types), type);
+
+	state.counts[t < 0 ? NELEM(types) : (size_t) t]++;
+
+	// Drivers end messages with a newline:
+	if (length < 0)
+		length = strlen(message);
+
+	while (length > 0 && message[length - 1] == '\n')
+		length--;
+
+	fprintf(stderr, "{ \"gl\": \"%s\", \"source\": \"%s\", \"severity\": \"%s\", \"id\": %u, \"group\": ",
+		LOOKUP(types, type), LOOKUP(sources, source), LOOKUP(severities, severity), id);
+
+	int depth = state.depth < MAX_GROUPS ? state.depth : MAX_GROUPS;
+
+	print_string(depth > 0 ? state.groups[depth - 1] : "", -1);
+	fputs(", \"message\": ", stderr);
+	print_string(message, length);
+	fputs(" }\n", stderr);
+}
+
+static void
+warn (GLuint id, GLenum severity, const char *message)
+{
+	glDebugMessageInsert(GL_DEBUG_SOURCE_APPLICATION, GL_DEBUG_TYPE_PERFORMANCE,
+		id, severity, -1, message);
+}
+
+// Install the message callback on the current context. Messages arrive on
+// the thread that caused them, while the offending call is on the stack:
+void
+debug_init (void)
+{
+	memset(&state, 0, sizeof(state));
+
+	if (!extension_version(430) && !extension_supported("GL_KHR_debug")) {
+		fputs("GL debug output needs OpenGL 4.3 or KHR_debug\n", stderr);
+		return;
+	}
+
+	GLint flags;
+	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+
+	if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+		fputs("Not a debug context; the driver may report less\n", stderr);
+
+	glEnable(GL_DEBUG_OUTPUT);
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDebugMessageCallback(callback, NULL);
+
+	// Everything but notifications, which are noise except for the
+	// driver's performance hints:
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_TRUE);
+
+	// Groups are logged with each message instead:
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PUSH_GROUP, GL_DONT_CARE, 0, NULL, GL_FALSE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_POP_GROUP,  GL_DONT_CARE, 0, NULL, GL_FALSE);
+
+	state.enabled = true;
+
+	// The whole pipeline falls back to the CPU:
+	const char *renderer = (const char *) glGetString(GL_RENDERER);
+	const char *software[] = { "llvmpipe", "softpipe", "swrast", "SwiftShader" };
+
+	FOREACH (software, s)
+		if (strstr(renderer, *s) != NULL) {
+			char message[256];
+
+			snprintf(message, sizeof(message), "Software renderer: %s", renderer);
+			warn(MSG_SOFTWARE, GL_DEBUG_SEVERITY_MEDIUM, message);
+			break;
+		}
+}
+
+// Label a GL object with its owner and kind, e.g. "model buffer". Names
+// from glGen* only become objects when first bound, so bind them briefly
+// where that sets no type; textures are labeled once they have storage:
+void
+debug_label (GLenum identifier, GLuint name, const char *owner, const char *kind)
+{
+	char label[64];
+	GLint prev;
+
+	if (!state.enabled || name == 0)
+		return;
+
+	snprintf(label, sizeof(label), "%s %s", owner, kind);
+
+	switch (identifier)
+	{
+	case GL_BUFFER:
+		glGetIntegerv(GL_COPY_WRITE_BUFFER_BINDING, &prev);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, name);
+		glObjectLabel(identifier, name, -1, label);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, prev);
+		break;
+
+	case GL_VERTEX_ARRAY:
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prev);
+		glBindVertexArray(name);
+		glObjectLabel(identifier, name, -1, label);
+		glBindVertexArray(prev);
+		break;
+
+	case GL_RENDERBUFFER:
+		glGetIntegerv(GL_RENDERBUFFER_BINDING, &prev);
+		glBindRenderbuffer(GL_RENDERBUFFER, name);
+		glObjectLabel(identifier, name, -1, label);
+		glBindRenderbuffer(GL_RENDERBUFFER, prev);
+		break;
+
+	case GL_FRAMEBUFFER:
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prev);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, name);
+		glObjectLabel(identifier, name, -1, label);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prev);
+		break;
+
+	default:
+		glObjectLabel(identifier, name, -1, label);
+		break;
+	}
+}
+
+// Open a debug group, shown in GL debuggers and logged with each message:
+void
+debug_push (const char *name)
+{
+	if (!state.enabled)
+		return;
+
+	glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+
+	if (state.depth < MAX_GROUPS)
+		state.groups[state.depth] = name;
+
+	state.depth++;
+}
+
+void
+debug_pop (void)
+{
+	if (!state.enabled || state.depth == 0)
+		return;
+
+	glPopDebugGroup();
+	state.depth--;
+}
+
+void
+debug_scope_end (const char **name)
+{
+	(void) name;
+	debug_pop();
+}
+
+// FNV-1a:
+static uint64_t
+hash (const uint8_t *data, size_t size)
+{
+	uint64_t h = 0xcbf29ce484222325;
+
+	for (size_t i = 0; i < size; i++)
+		h = (h ^ data[i]) * 0x100000001b3;
+
+	return h;
+}
+
+// Warn when a buffer range is uploaded with the same contents it already
+// holds. Call next to the glBufferData or glBufferSubData:
+void
+debug_upload (GLuint buffer, size_t offset, const void *data, size_t size)
+{
+	struct upload *u = NULL;
+
+	if (!state.enabled || data == NULL)
+		return;
+
+	uint64_t h = hash(data, size);
+
+	FOREACH_NELEM (state.uploads, state.nuploads, v)
+		if (v->buffer == buffer && v->offset == offset && v->size == size) {
+			u = v;
+			break;
+		}
+
+	if (u != NULL && u->hash == h) {
+		char label[64] = "";
+		char message[256];
+
+		glGetObjectLabel(GL_BUFFER, buffer, sizeof(label), NULL, label);
+		snprintf(message, sizeof(message),
+			"Redundant upload of %zu unchanged bytes at offset %zu to buffer %u (%s)",
+			size, offset, buffer, label);
+
+		warn(MSG_REDUNDANT_UPLOAD, GL_DEBUG_SEVERITY_LOW, message);
+		return;
+	}
+
+	// Remember the range, replacing the oldest when full:
+	if (u == NULL) {
+		if (state.nuploads < MAX_UPLOADS)
+			u = &state.uploads[state.nuploads++];
+		else
+			u = &state.uploads[state.next_upload++ % MAX_UPLOADS];
+	}
+
+	*u = (struct upload) {
+		.buffer = buffer,
+		.offset = offset,
+		.size   = size,
+		.hash   = h,
+	};
+}
+
+// Print the number of messages of each type:
+void
+debug_report (void)
+{
+	if (!state.enabled)
+		return;
+
+	fputs("GL debug messages:", stderr);
+
+	for (size_t i = 0; i < NELEM(types); i++)
+		fprintf(stderr, " %zu %s%s", state.counts[i], types[i].name, i + 1 < NELEM(types) ? "," : "\n");
+}
+
+#endif
@@ -0,0 +1,46 @@
+// OpenGL debug output through KHR_debug: driver messages and performance
+// warnings as structured log lines, object labels and debug groups. Enabled
+// by building with -DDEBUG; otherwise the macros compile to nothing.
+
+#ifdef DEBUG
+
+#include <stddef.h>
+#include <GL/gl.h>
+
+void debug_init (void);
+void debug_label (GLenum identifier, GLuint name, const char *owner, const char *kind);
+void debug_push (const char *name);
+void debug_pop (void);
+void debug_scope_end (const char **name);
+void debug_upload (GLuint buffer, size_t offset, const void *data, size_t size);
+void debug_report (void);
+
+#define DEBUG_CONCAT_(a, b)	a ## b
+#define DEBUG_CONCAT(a, b)	DEBUG_CONCAT_(a, b)
+
+#define DEBUG_INIT()				debug_init()
+#define DEBUG_LABEL(identifier, name, owner, kind) \
+	debug_label((identifier), (name), (owner), (kind))
+#define DEBUG_PUSH(name)			debug_push(name)
+#define DEBUG_POP()				debug_pop()
+#define DEBUG_UPLOAD(buffer, offset, data, size) \
+	debug_upload((buffer), (offset), (data), (size))
+#define DEBUG_REPORT()				debug_report()
+
+// Group the GL calls until the end of the enclosing block:
+#define DEBUG_SCOPE(name)						\
+	__attribute__((cleanup(debug_scope_end)))			\
+	const char *DEBUG_CONCAT(debug_scope_, __LINE__) =		\
+		(debug_push(name), (name))
+
+#else
+
+#define DEBUG_INIT()					do { } while (0)
+#define DEBUG_LABEL(identifier, name, owner, kind)	do { } while (0)
+#define DEBUG_PUSH(name)				do { } while (0)
+#define DEBUG_POP()					do { } while (0)
+#define DEBUG_UPLOAD(buffer, offset, data, size)	do { } while (0)
+#define DEBUG_REPORT()					do { } while (0)
+#define DEBUG_SCOPE(name)				do { } while (0)
+
+#endif
@@ -0,0 +1,33 @@
+#include <stdbool.h>
+#include <string.h>
+#include <GL/gl.h>
+
+#include "extension.h"
+
+// Check whether the current context supports the named extension:
+bool
+extension_supported (const char *name)
+{
+	GLint num;
+
+	glGetIntegerv(GL_NUM_EXTENSIONS, &num);
+
+	for (GLint i = 0; i < num; i++)
+		if (strcmp((const char *) glGetStringi(GL_EXTENSIONS, i), name) == 0)
+			return true;
+
+	return false;
+}
+
+// Check whether the context version is at least the given version, written
+// like a GLSL version number, e.g. 430 for OpenGL 4.3:
+bool
+extension_version (int version)
+{
+	GLint major, minor;
+
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+	return major * 100 + minor * 10 >= version;
+}
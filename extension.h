@@ -0,0 +1,4 @@
+#include <stdbool.h>
+
+bool extension_supported (const char *name);
+bool extension_version (int version);
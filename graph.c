@@ -0,0 +1,753 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <GL/gl.h>
+
+#include "debug.h"
+#include "extension.h"
+#include "graph.h"
+#include "resource.h"
+#include "stats.h"
+#include "trace.h"
+#include "util.h"
+
+#define MAX_PASSES	32
+#define MAX_ATTACHMENTS	32
+
+// Attachments from here on are transient, owned by the graph:
+#define FIRST_TRANSIENT	(GRAPH_BACKBUFFER_DEPTH + 1)
+
+static const struct {
+	GLenum	internal;
+	GLenum	format;
+	GLenum	type;
+	size_t	bytes;
+	bool	depth;
+}
+formats[] = {
+	[GRAPH_RGBA8]   = { GL_RGBA8,             GL_RGBA,            GL_UNSIGNED_BYTE, 4, false },
+	[GRAPH_RGBA16F] = { GL_RGBA16F,           GL_RGBA,            GL_FLOAT,         8, false },
+	[GRAPH_DEPTH]   = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT,  4, true  },
+};
+
+struct attachment {
+	const char		*name;
+	enum graph_format	 format;
+	float			 scale;
+	int			 writer;	// Last pass to write, in declaration order
+	int			 first;		// Lifetime, in execution order
+	int			 last;
+	int			 physical;
+};
+
+// Memory shared by attachments whose lifetimes do not overlap:
+struct physical {
+	enum graph_format	 format;
+	float			 scale;
+	bool			 texture;	// Sampled, else a renderbuffer
+	int			 last;		// Last use so far, in execution order
+	GLuint			 id;
+};
+
+struct pass {
+	struct graph_pass	 desc;
+	int			 deps[2 * GRAPH_MAX_IO];
+	int			 ndeps;
+	bool			 live;
+	bool			 backbuffer;	// Draws into the bound framebuffer
+	float			 scale;
+	GLuint			 fbo;
+	GLuint			 query;
+	bool			 pending;
+	double			 cpu;
+	double			 gpu;
+	size_t			 frames;
+	size_t			 gpu_frames;
+};
+
+static struct {
+	struct pass		 passes[MAX_PASSES];
+	size_t			 npasses;
+	struct attachment	 attachments[MAX_ATTACHMENTS];	// By id
+	size_t			 nattachments;
+	struct physical		 physical[MAX_ATTACHMENTS];
+	size_t			 nphysical;
+	int			 order[MAX_PASSES];		// Live passes
+	size_t			 norder;
+	bool			 compiled;
+	bool			 allocated;
+	bool			 timers;
+	int			 width;
+	int			 height;
+} graph;
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Length of a zero-terminated attachment list:
+static int
+list_len (const int *list)
+{
+	int n = 0;
+
+	while (n < GRAPH_MAX_IO && list[n] != 0)
+		n++;
+
+	return n;
+}
+
+static bool
+valid (int id)
+{
+	return id > 0 && (size_t) id < graph.nattachments;
+}
+
+static int
+scaled (int size, float scale)
+{
+	int s = size * scale;
+
+	return s > 0 ? s : 1;
+}
+
+static size_t
+bytes (enum graph_format format, float scale)
+{
+	return (size_t) scaled(graph.width, scale) * scaled(graph.height, scale) * formats[format].bytes;
+}
+
+// Declare a transient attachment, sized relative to the window, and return
+// its id. Its memory may be shared with other transient attachments:
+int
+graph_attachment (const char *name, enum graph_format format, float scale)
+{
+	if (graph.nattachments < FIRST_TRANSIENT)
+		graph.nattachments = FIRST_TRANSIENT;
+
+	if (graph.nattachments == MAX_ATTACHMENTS) {
+		fprintf(stderr, "Render graph: too many attachments for %s\n", name);
+		return 0;
+	}
+
+	graph.attachments[graph.nattachments] = (struct attachment) {
+		.name   = name,
+		.format = format,
+		.scale  = scale,
+	};
+
+	graph.compiled = false;
+	return graph.nattachments++;
+}
+
+// Add a pass. Passes that write the same attachment run in the order they
+// are added; otherwise, the order follows from what they read:
+void
+graph_add (const struct graph_pass *pass)
+{
+	if (graph.npasses == MAX_PASSES) {
+		fprintf(stderr, "Render graph: too many passes for %s\n", pass->name);
+		return;
+	}
+
+	graph.passes[graph.npasses++] = (struct pass) { .desc = *pass };
+	graph.compiled = false;
+}
+
+// Delete the GL objects backing the graph; they are created again on the
+// next run:
+static void
+release (void)
+{
+	FOREACH_NELEM (graph.physical, graph.nphysical, m) {
+		resource_delete(m->texture ? RESOURCE_TEXTURE : RESOURCE_RENDERBUFFER, m->id);
+		m->id = 0;
+	}
+
+	FOREACH_NELEM (graph.passes, graph.npasses, p) {
+		resource_delete(RESOURCE_FRAMEBUFFER, p->fbo);
+		resource_delete(RESOURCE_QUERY, p->query);
+		p->fbo = p->query = 0;
+		p->pending = false;
+	}
+
+	graph.allocated = false;
+}
+
+static bool
+fail (const struct pass *p, const char *what, int id)
+{
+	fprintf(stderr, "Render graph: pass %s %s %s\n", p->desc.name, what,
+		valid(id) ? graph.attachments[id].name : "an unknown attachment");
+
+	return false;
+}
+
+static void
+add_dep (struct pass *p, int dep)
+{
+	for (int i = 0; i < p->ndeps; i++)
+		if (p->deps[i] == dep)
+			return;
+
+	p->deps[p->ndeps++] = dep;
+}
+
+// Link each pass to the passes whose output it needs:
+static bool
+link_passes (void)
+{
+	for (size_t i = 0; i < graph.npasses; i++) {
+		struct pass *p = &graph.passes[i];
+		const int *w = p->desc.write, *c = p->desc.clear;
+		const int *lists[] = { w, c };
+		int transient = 0;
+
+		p->ndeps = 0;
+		p->live  = false;
+		p->backbuffer = false;
+		p->scale = 0.0f;
+
+		// Drawing over an attachment needs its previous writer:
+		for (int j = 0; j < list_len(w); j++) {
+			if (!valid(w[j]))
+				return fail(p, "writes", w[j]);
+
+			if (graph.attachments[w[j]].writer >= 0)
+				add_dep(p, graph.attachments[w[j]].writer);
+		}
+
+		for (int j = 0; j < list_len(c); j++)
+			if (!valid(c[j]))
+				return fail(p, "clears", c[j]);
+
+		// Record this pass as the latest writer, and check that it draws
+		// into one framebuffer of one size:
+		FOREACH (lists, list)
+			for (int j = 0; j < list_len(*list); j++) {
+				int id = (*list)[j];
+				struct attachment *a = &graph.attachments[id];
+
+				a->writer = i;
+
+				if (id < FIRST_TRANSIENT) {
+					p->backbuffer = true;
+					continue;
+				}
+
+				if (transient && a->scale != p->scale)
+					return fail(p, "mixes sizes with", id);
+
+				transient = id;
+				p->scale  = a->scale;
+			}
+
+		if (p->backbuffer && transient)
+			return fail(p, "mixes the backbuffer with", transient);
+	}
+
+	// Reading an attachment needs its final contents:
+	FOREACH_NELEM (graph.passes, graph.npasses, p) {
+		const int *r = p->desc.read;
+
+		for (int j = 0; j < list_len(r); j++) {
+			if (!valid(r[j]) || r[j] < FIRST_TRANSIENT)
+				return fail(p, "cannot read", r[j]);
+
+			int writer = graph.attachments[r[j]].writer;
+
+			if (writer < 0)
+				return fail(p, "reads unwritten", r[j]);
+
+			if (&graph.passes[writer] == p)
+				return fail(p, "reads its own output", r[j]);
+
+			add_dep(p, writer);
+		}
+	}
+
+	return true;
+}
+
+static void
+mark_live (int index)
+{
+	struct pass *p = &graph.passes[index];
+
+	if (p->live)
+		return;
+
+	p->live = true;
+
+	for (int i = 0; i < p->ndeps; i++)
+		mark_live(p->deps[i]);
+}
+
+// Order the live passes so that each runs after its dependencies, keeping
+// the order in which they were added where there is a choice:
+static bool
+order_passes (void)
+{
+	bool done[MAX_PASSES] = { false };
+	size_t live = 0;
+
+	FOREACH_NELEM (graph.passes, graph.npasses, p)
+		live += p->live;
+
+	for (graph.norder = 0; graph.norder < live; graph.norder++) {
+		int next = -1;
+
+		for (size_t i = 0; i < graph.npasses && next < 0; i++) {
+			const struct pass *p = &graph.passes[i];
+			bool ready = p->live && !done[i];
+
+			for (int j = 0; j < p->ndeps && ready; j++)
+				ready = done[p->deps[j]];
+
+			if (ready)
+				next = i;
+		}
+
+		if (next < 0) {
+			fputs("Render graph: passes depend on each other in a cycle\n", stderr);
+			return false;
+		}
+
+		done[next] = true;
+		graph.order[graph.norder] = next;
+	}
+
+	return true;
+}
+
+// Give an attachment memory that no other attachment uses during its
+// lifetime, reusing memory where possible:
+static int
+alias (const struct attachment *a, bool texture)
+{
+	for (size_t i = 0; i < graph.nphysical; i++) {
+		struct physical *m = &graph.physical[i];
+
+		if (m->format != a->format || m->scale != a->scale || m->texture != texture)
+			continue;
+
+		if (m->last >= a->first)
+			continue;
+
+		m->last = a->last;
+		return i;
+	}
+
+	graph.physical[graph.nphysical] = (struct physical) {
+		.format  = a->format,
+		.scale   = a->scale,
+		.texture = texture,
+		.last    = a->last,
+	};
+
+	return graph.nphysical++;
+}
+
+// Find the lifetimes of the transient attachments in execution order, and
+// alias those that never live at the same time:
+static void
+assign_memory (void)
+{
+	bool sampled[MAX_ATTACHMENTS] = { false };
+
+	for (size_t k = 0; k < graph.norder; k++) {
+		const struct pass *p = &graph.passes[graph.order[k]];
+		const int *lists[] = { p->desc.read, p->desc.write, p->desc.clear };
+
+		FOREACH (lists, list)
+			for (int j = 0; j < list_len(*list); j++) {
+				struct attachment *a = &graph.attachments[(*list)[j]];
+
+				if (a->first < 0)
+					a->first = k;
+
+				a->last = k;
+			}
+
+		for (int j = 0; j < list_len(p->desc.read); j++)
+			sampled[p->desc.read[j]] = true;
+	}
+
+	graph.nphysical = 0;
+
+	for (size_t k = 0; k < graph.norder; k++)
+		for (size_t i = FIRST_TRANSIENT; i < graph.nattachments; i++) {
+			struct attachment *a = &graph.attachments[i];
+
+			if (a->first == (int) k)
+				a->physical = alias(a, sampled[i]);
+		}
+}
+
+// Work out the pass order, drop passes that do not contribute to the
+// backbuffer, and alias the transient attachments. Touches no GL state
+// besides deleting the previous allocation:
+bool
+graph_compile (void)
+{
+	TRACE_FUNC();
+
+	release();
+
+	if (graph.nattachments < FIRST_TRANSIENT)
+		graph.nattachments = FIRST_TRANSIENT;
+
+	graph.attachments[GRAPH_BACKBUFFER].name         = "backbuffer";
+	graph.attachments[GRAPH_BACKBUFFER_DEPTH].name   = "backbuffer depth";
+	graph.attachments[GRAPH_BACKBUFFER_DEPTH].format = GRAPH_DEPTH;
+
+	FOREACH_NELEM (graph.attachments, graph.nattachments, a) {
+		a->writer   = -1;
+		a->first    = -1;
+		a->last     = -1;
+		a->physical = -1;
+	}
+
+	graph.compiled = false;
+	graph.norder   = 0;
+
+	if (!link_passes())
+		return false;
+
+	// Whatever ends up in the backbuffer is live:
+	for (int i = GRAPH_BACKBUFFER; i < FIRST_TRANSIENT; i++)
+		if (graph.attachments[i].writer >= 0)
+			mark_live(graph.attachments[i].writer);
+
+	if (!order_passes())
+		return false;
+
+	assign_memory();
+
+	return graph.compiled = true;
+}
+
+// Size the transient attachments for the window; they are reallocated on
+// the next run:
+void
+graph_set_window (int width, int height)
+{
+	if (width == graph.width && height == graph.height)
+		return;
+
+	release();
+
+	graph.width  = width;
+	graph.height = height;
+}
+
+static void
+create_physical (struct physical *m)
+{
+	GLsizei width  = scaled(graph.width,  m->scale);
+	GLsizei height = scaled(graph.height, m->scale);
+	GLenum internal = formats[m->format].internal;
+
+	if (!m->texture) {
+		m->id = resource_create(RESOURCE_RENDERBUFFER, "graph");
+		glBindRenderbuffer(GL_RENDERBUFFER, m->id);
+		glRenderbufferStorage(GL_RENDERBUFFER, internal, width, height);
+		resource_size(RESOURCE_RENDERBUFFER, m->id, bytes(m->format, m->scale));
+		return;
+	}
+
+	m->id = resource_create(RESOURCE_TEXTURE, "graph");
+	glBindTexture(GL_TEXTURE_2D, m->id);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, internal, width, height, 0,
+		formats[m->format].format, formats[m->format].type, NULL);
+
+	resource_size(RESOURCE_TEXTURE, m->id, bytes(m->format, m->scale));
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+}
+
+// Color attachment index of an attachment written by a pass, or -1 for
+// depth. Colors are attached in the order of the write and clear lists:
+static int
+color_index (const struct pass *p, int id)
+{
+	const int *lists[] = { p->desc.write, p->desc.clear };
+	int index = 0;
+
+	FOREACH (lists, list)
+		for (int j = 0; j < list_len(*list); j++) {
+			if ((*list)[j] == id)
+				return formats[graph.attachments[id].format].depth ? -1 : index;
+
+			if (!formats[graph.attachments[(*list)[j]].format].depth)
+				index++;
+		}
+
+	return -1;
+}
+
+static void
+create_framebuffer (struct pass *p)
+{
+	const int *lists[] = { p->desc.write, p->desc.clear };
+	GLenum buffers[2 * GRAPH_MAX_IO];
+	int nbuffers = 0;
+
+	p->fbo = resource_create(RESOURCE_FRAMEBUFFER, "graph");
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p->fbo);
+
+	FOREACH (lists, list)
+		for (int j = 0; j < list_len(*list); j++) {
+			const struct attachment *a = &graph.attachments[(*list)[j]];
+			const struct physical *m = &graph.physical[a->physical];
+			int index = color_index(p, (*list)[j]);
+			GLenum point = index < 0 ? GL_DEPTH_ATTACHMENT : GL_COLOR_ATTACHMENT0 + index;
+
+			if (m->texture)
+				glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, point, GL_TEXTURE_2D, m->id, 0);
+			else
+				glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, point, GL_RENDERBUFFER, m->id);
+
+			if (index >= 0)
+				buffers[nbuffers++] = point;
+		}
+
+	if (nbuffers > 0)
+		glDrawBuffers(nbuffers, buffers);
+	else
+		glDrawBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		fprintf(stderr, "Render graph: framebuffer of pass %s incomplete\n", p->desc.name);
+}
+
+// Create the memory of the transient attachments and the framebuffers of
+// the passes that draw into them:
+static void
+allocate (void)
+{
+	TRACE_FUNC();
+
+	graph.timers = extension_version(330) || extension_supported("GL_ARB_timer_query");
+
+	FOREACH_NELEM (graph.physical, graph.nphysical, m)
+		create_physical(m);
+
+	for (size_t k = 0; k < graph.norder; k++) {
+		struct pass *p = &graph.passes[graph.order[k]];
+
+		if (!p->backbuffer)
+			create_framebuffer(p);
+
+		if (graph.timers)
+			p->query = resource_create(RESOURCE_QUERY, "graph");
+	}
+
+	graph.allocated = true;
+}
+
+// Add the GPU time of the pass's previous run, if it is in:
+static void
+collect (struct pass *p)
+{
+	GLint available;
+	GLuint64 ns;
+
+	if (!p->pending)
+		return;
+
+	glGetQueryObjectiv(p->query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+	if (!available)
+		return;
+
+	glGetQueryObjectui64v(p->query, GL_QUERY_RESULT, &ns);
+
+	p->gpu += ns * 1e-9;
+	p->gpu_frames++;
+	p->pending = false;
+}
+
+static void
+clear (const struct pass *p)
+{
+	const int *c = p->desc.clear;
+	const GLfloat color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	const GLfloat depth = 1.0f;
+
+	for (int j = 0; j < list_len(c); j++) {
+		int index = color_index(p, c[j]);
+
+		if (index < 0)
+			glClearBufferfv(GL_DEPTH, 0, &depth);
+		else
+			glClearBufferfv(GL_COLOR, index, color);
+	}
+}
+
+// Run all live passes in order, into the framebuffer that is bound:
+void
+graph_execute (void)
+{
+	TRACE_FUNC();
+
+	if (!graph.compiled)
+		return;
+
+	GLint backbuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &backbuffer);
+
+	if (!graph.allocated)
+		allocate();
+
+	for (size_t k = 0; k < graph.norder; k++) {
+		struct pass *p = &graph.passes[graph.order[k]];
+		const int *r = p->desc.read;
+
+		collect(p);
+		DEBUG_PUSH(p->desc.name);
+
+		if (p->backbuffer) {
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, backbuffer);
+			glViewport(0, 0, graph.width, graph.height);
+		}
+		else {
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, p->fbo);
+			glViewport(0, 0, scaled(graph.width, p->scale), scaled(graph.height, p->scale));
+		}
+
+		clear(p);
+
+		for (int j = 0; j < list_len(r); j++) {
+			glActiveTexture(GL_TEXTURE0 + j);
+			glBindTexture(GL_TEXTURE_2D, graph.physical[graph.attachments[r[j]].physical].id);
+		}
+
+		glActiveTexture(GL_TEXTURE0);
+		stats_count(STAT_TEXTURES, list_len(r));
+
+		// Time only one run at a time per pass:
+		bool timed = graph.timers && !p->pending;
+
+		if (timed)
+			glBeginQuery(GL_TIME_ELAPSED, p->query);
+
+		double start = now();
+		p->desc.run();
+		p->cpu += now() - start;
+		p->frames++;
+
+		if (timed) {
+			glEndQuery(GL_TIME_ELAPSED);
+			p->pending = true;
+		}
+
+		// Unbind the inputs, so that later passes can draw into their
+		// memory without sampling from it:
+		for (int j = 0; j < list_len(r); j++) {
+			glActiveTexture(GL_TEXTURE0 + j);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+
+		glActiveTexture(GL_TEXTURE0);
+		DEBUG_POP();
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, backbuffer);
+	glViewport(0, 0, graph.width, graph.height);
+}
+
+// Get the average cost of the live passes, in execution order:
+size_t
+graph_timings (struct graph_timing *timings, size_t max)
+{
+	size_t n = 0;
+
+	for (size_t k = 0; k < graph.norder && n < max; k++) {
+		struct pass *p = &graph.passes[graph.order[k]];
+
+		collect(p);
+
+		timings[n++] = (struct graph_timing) {
+			.name   = p->desc.name,
+			.cpu_ms = p->frames ? p->cpu * 1e3 / p->frames : 0.0,
+			.gpu_ms = p->gpu_frames ? p->gpu * 1e3 / p->gpu_frames : -1.0,
+		};
+	}
+
+	return n;
+}
+
+void
+graph_stats (struct graph_stats *stats)
+{
+	*stats = (struct graph_stats) {
+		.passes   = graph.npasses,
+		.culled   = graph.npasses - graph.norder,
+		.physical = graph.nphysical,
+	};
+
+	for (size_t i = FIRST_TRANSIENT; i < graph.nattachments; i++) {
+		const struct attachment *a = &graph.attachments[i];
+
+		if (a->physical < 0)
+			continue;
+
+		stats->attachments++;
+		stats->unaliased_bytes += bytes(a->format, a->scale);
+	}
+
+	FOREACH_NELEM (graph.physical, graph.nphysical, m)
+		stats->transient_bytes += bytes(m->format, m->scale);
+}
+
+// Print the pass order with the average cost of each pass, the culled
+// passes, and the transient memory with and without aliasing:
+void
+graph_report (void)
+{
+	struct graph_timing timings[MAX_PASSES];
+	struct graph_stats stats;
+	size_t n = graph_timings(timings, MAX_PASSES);
+
+	graph_stats(&stats);
+
+	printf("Render graph: %zu passes, %zu culled\n", stats.passes, stats.culled);
+	printf("  %-16s %8s %8s\n", "pass", "cpu ms", "gpu ms");
+
+	FOREACH_NELEM (timings, n, t)
+		if (t->gpu_ms < 0.0)
+			printf("  %-16s %8.3f %8s\n", t->name, t->cpu_ms, "-");
+		else
+			printf("  %-16s %8.3f %8.3f\n", t->name, t->cpu_ms, t->gpu_ms);
+
+	FOREACH_NELEM (graph.passes, graph.npasses, p)
+		if (graph.compiled && !p->live)
+			printf("  %-16s culled\n", p->desc.name);
+
+	printf("Transient memory: %zu attachments in %zu, %.2f MiB (%.2f MiB unaliased)\n",
+		stats.attachments, stats.physical,
+		stats.transient_bytes / 1048576.0, stats.unaliased_bytes / 1048576.0);
+}
+
+// Delete the GL objects and forget all passes and attachments, as when the
+// GL context goes away:
+void
+graph_destroy (void)
+{
+	release();
+	memset(&graph, 0, sizeof(graph));
+}
@@ -0,0 +1,52 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+// The color and depth attachments of the framebuffer that is bound when
+// the graph runs, e.g. that of the GL area:
+#define GRAPH_BACKBUFFER	1
+#define GRAPH_BACKBUFFER_DEPTH	2
+
+// Most attachments a pass can read, write or clear:
+#define GRAPH_MAX_IO	4
+
+enum graph_format {
+	GRAPH_RGBA8,
+	GRAPH_RGBA16F,
+	GRAPH_DEPTH,
+};
+
+// A pass, and the attachments it uses. The lists end at the first zero.
+// Read attachments are bound to texture units 0, 1, ... in list order:
+struct graph_pass {
+	const char	*name;
+	void		(*run) (void);
+	int		 read[GRAPH_MAX_IO];	// Sampled
+	int		 write[GRAPH_MAX_IO];	// Drawn over previous contents
+	int		 clear[GRAPH_MAX_IO];	// Cleared, then drawn
+};
+
+// Cost of a pass, averaged over the frames it ran:
+struct graph_timing {
+	const char	*name;
+	double		 cpu_ms;
+	double		 gpu_ms;	// Negative without timer queries
+};
+
+struct graph_stats {
+	size_t	passes;		// Declared
+	size_t	culled;		// Not contributing to the backbuffer
+	size_t	attachments;	// Transient, as declared
+	size_t	physical;	// Transient, after aliasing
+	size_t	transient_bytes;
+	size_t	unaliased_bytes;
+};
+
+int graph_attachment (const char *name, enum graph_format format, float scale);
+void graph_add (const struct graph_pass *pass);
+bool graph_compile (void);
+void graph_set_window (int width, int height);
+void graph_execute (void);
+size_t graph_timings (struct graph_timing *timings, size_t max);
+void graph_stats (struct graph_stats *stats);
+void graph_report (void);
+void graph_destroy (void);
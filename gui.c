@@ -3,10 +3,23 @@
 #include <GL/gl.h>
 #include <gtk/gtk.h>
 
+#ifdef GDK_WINDOWING_X11
+#include <gdk/gdkx.h>
+#endif
+
 #include "background.h"
+#include "debug.h"
+#include "graph.h"
 #include "matrix.h"
 #include "model.h"
+#include "pack.h"
+#include "pick.h"
+#include "post.h"
+#include "present.h"
 #include "program.h"
+#include "resource.h"
+#include "startup.h"
+#include "trace.h"
 #include "util.h"
 #include "view.h"
 
@@ -18,35 +31,151 @@ struct signal {
 };
 
 static gboolean panning = FALSE;
+static enum pick_backend pick_backend = PICK_CPU;
+static gint bloom = 0;
+static enum present_backend present_backend = PRESENT_AREA;
+static gint swap_interval = 1;
+static guint tick;
+
+// Whether the EGL surface is set up, and whether init_gl left a scene
+// to render:
+static gboolean presenting;
+static gboolean ready;
+
+// The model pass is the only one that tests depth; the background and
+// post-processing passes draw over the whole frame:
+static void
+draw_model (void)
+{
+	glEnable(GL_DEPTH_TEST);
+	model_draw();
+	glDisable(GL_DEPTH_TEST);
+}
 
+// Size everything for a framebuffer of the given size in pixels:
 static void
-on_resize (GtkGLArea *area, gint width, gint height)
+set_window (gint width, gint height)
 {
 	view_set_window(width, height);
 	background_set_window(width, height);
+	graph_set_window(width, height);
+}
+
+static void
+on_resize (GtkGLArea *area, gint width, gint height)
+{
+	TRACE_FUNC();
+
+	set_window(width, height);
+}
+
+// Declare the passes of a frame: the background and the model, drawn into
+// the GL area, or into an offscreen scene for the bloom to work on:
+static void
+build_graph (void)
+{
+	int color = GRAPH_BACKBUFFER;
+	int depth = GRAPH_BACKBUFFER_DEPTH;
+
+	if (bloom > 0) {
+		color = graph_attachment("scene", GRAPH_RGBA8, 1.0f);
+		depth = graph_attachment("scene depth", GRAPH_DEPTH, 1.0f);
+	}
+
+	// The background covers the whole frame, so nothing is cleared first:
+	graph_add(&(struct graph_pass) {
+		.name  = "background",
+		.run   = background_draw,
+		.write = { color },
+	});
+
+	// Don't clip against background:
+	graph_add(&(struct graph_pass) {
+		.name  = "model",
+		.run   = draw_model,
+		.write = { color },
+		.clear = { depth },
+	});
+
+	if (bloom > 0)
+		post_add(color, GRAPH_BACKBUFFER, bloom);
+
+	graph_compile();
+}
+
+// Render a frame into the bound framebuffer:
+static void
+render_frame (void)
+{
+	// Draw background and model, and any post-processing:
+	graph_execute();
+
+	// Report startup timeline after the first frame:
+	startup_frame_done();
+
+	// Report a picked object when its result is in:
+	struct pick pick;
+
+	if (pick_frame(&pick))
+		printf("Picked object %d at (%d, %d) on the %s after %u frames\n",
+			pick.object, pick.x, pick.y,
+			pick_backend_name(pick.backend), pick.latency);
 }
 
 static gboolean
 on_render (GtkGLArea *glarea, GdkGLContext *context)
 {
-	// Clear canvas:
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-	// Draw background:
-	background_draw();
+	TRACE_FUNC();
 
-	// Draw model:
-	model_draw();
+	if (ready)
+		render_frame();
 
 	// Don't propagate signal:
 	return TRUE;
 }
 
-static void
-on_realize (GtkGLArea *glarea)
+#ifdef DEBUG
+
+// Ask for a debug context, so that the driver reports all it can:
+static GdkGLContext *
+on_create_context (GtkGLArea *glarea)
 {
-	// Make current:
-	gtk_gl_area_make_current(glarea);
+	TRACE_FUNC();
+
+	GError *error = NULL;
+	GdkWindow *window = gtk_widget_get_window(GTK_WIDGET(glarea));
+	GdkGLContext *context = gdk_window_create_gl_context(window, &error);
+	gint major, minor;
+
+	if (context == NULL) {
+		gtk_gl_area_set_error(glarea, error);
+		g_clear_error(&error);
+		return NULL;
+	}
+
+	gtk_gl_area_get_required_version(glarea, &major, &minor);
+	gdk_gl_context_set_required_version(context, major, minor);
+	gdk_gl_context_set_debug_enabled(context, TRUE);
+
+	if (!gdk_gl_context_realize(context, &error)) {
+		gtk_gl_area_set_error(glarea, error);
+		g_clear_error(&error);
+		g_object_unref(context);
+		return NULL;
+	}
+
+	return context;
+}
+
+#endif
+
+// Set up everything once the context is current. Fails if there is nothing
+// to draw; destroy_gl still cleans up after a failure:
+static gboolean
+init_gl (void)
+{
+	// Log GL errors and performance warnings in debug builds:
+	DEBUG_INIT();
 
 	// Print version info:
 	const GLubyte* renderer = glGetString(GL_RENDERER);
@@ -54,17 +183,58 @@ on_realize (GtkGLArea *glarea)
 	printf("Renderer: %s\n", renderer);
 	printf("OpenGL version supported %s\n", version);
 
-	// Enable depth buffer:
-	gtk_gl_area_set_has_depth_buffer(glarea, TRUE);
+	// Init programs, background and model:
+	if (!startup_run()) {
+		fputs("Could not build a model to draw\n", stderr);
+		return FALSE;
+	}
 
-	// Init programs:
-	programs_init();
+	// Init picking:
+	pick_init(pick_backend);
 
-	// Init background:
-	background_init();
+	// Declare the frame's passes:
+	build_graph();
 
-	// Init model:
-	model_init();
+	// Report GPU memory in use:
+	resource_report();
+
+	ready = TRUE;
+	return TRUE;
+}
+
+// Tear down everything while the context is still current:
+static void
+destroy_gl (void)
+{
+	// Report the cost of each pass over the whole run:
+	if (ready)
+		graph_report();
+
+	ready = FALSE;
+	graph_destroy();
+	post_destroy();
+
+	pick_destroy();
+	model_destroy();
+	background_destroy();
+	programs_destroy();
+
+	DEBUG_REPORT();
+}
+
+static void
+on_realize (GtkGLArea *glarea)
+{
+	TRACE_FUNC();
+
+	// Make current:
+	gtk_gl_area_make_current(glarea);
+
+	// Enable depth buffer:
+	gtk_gl_area_set_has_depth_buffer(glarea, TRUE);
+
+	if (!init_gl())
+		return;
 
 	// Get frame clock:
 	GdkGLContext *glcontext = gtk_gl_area_get_context(glarea);
@@ -83,24 +253,134 @@ on_realize (GtkGLArea *glarea)
 	gdk_frame_clock_begin_updating(frame_clock);
 }
 
+static void
+on_unrealize (GtkGLArea *glarea)
+{
+	TRACE_FUNC();
+
+	// The GL context is still current until unrealize returns:
+	gtk_gl_area_make_current(glarea);
+
+	if (gtk_gl_area_get_error(glarea) != NULL)
+		return;
+
+	destroy_gl();
+}
+
+#ifdef GDK_WINDOWING_X11
+
+// Direct presentation: a drawing area whose X11 window gets an EGL window
+// surface. Frames are swapped straight to it from a tick callback, instead
+// of being drawn into the GL area's framebuffer and composited by GDK:
+static gboolean
+on_tick (GtkWidget *widget, GdkFrameClock *frame_clock, gpointer data)
+{
+	TRACE_FUNC();
+
+	present_make_current();
+	render_frame();
+	present_swap();
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+on_surface_realize (GtkWidget *widget)
+{
+	TRACE_FUNC();
+
+	GdkWindow *window = gtk_widget_get_window(widget);
+	gint scale = gtk_widget_get_scale_factor(widget);
+	GtkAllocation allocation;
+
+	// The surface needs an X11 window of its own:
+	gdk_window_ensure_native(window);
+	gtk_widget_get_allocation(widget, &allocation);
+
+	if (!present_init
+		( gdk_x11_display_get_xdisplay(gdk_window_get_display(window))
+		, gdk_x11_window_get_xid(window)
+		, allocation.width  * scale
+		, allocation.height * scale
+		, swap_interval
+		)) {
+		fputs("Could not present to the window; try --present area\n", stderr);
+		return;
+	}
+
+	presenting = TRUE;
+
+	// Keep the surface for on_surface_unrealize, but don't draw:
+	if (!init_gl())
+		return;
+
+	set_window(allocation.width * scale, allocation.height * scale);
+
+	tick = gtk_widget_add_tick_callback(widget, on_tick, NULL, NULL);
+}
+
+static void
+on_surface_unrealize (GtkWidget *widget)
+{
+	TRACE_FUNC();
+
+	if (!presenting)
+		return;
+
+	if (tick != 0) {
+		gtk_widget_remove_tick_callback(widget, tick);
+		tick = 0;
+	}
+
+	present_make_current();
+	destroy_gl();
+	present_destroy();
+	presenting = FALSE;
+}
+
+static void
+on_surface_size_allocate (GtkWidget *widget, GdkRectangle *allocation)
+{
+	TRACE_FUNC();
+
+	gint scale = gtk_widget_get_scale_factor(widget);
+
+	// The window surface follows the window size by itself:
+	if (ready) {
+		present_make_current();
+		set_window(allocation->width * scale, allocation->height * scale);
+	}
+}
+
+#endif
+
 static gboolean
 on_button_press (GtkWidget *widget, GdkEventButton *event)
 {
+	TRACE_FUNC();
+
 	GtkAllocation allocation;
 	gtk_widget_get_allocation(widget, &allocation);
 
-	if (event->button == 1)
+	if (event->button == 1) {
 		if (panning == FALSE) {
 			panning = TRUE;
 			model_pan_start(event->x, allocation.height - event->y);
 		}
 
+		// Pick in framebuffer pixels, which may be scaled:
+		gint scale = gtk_widget_get_scale_factor(widget);
+		pick_request(event->x * scale, (allocation.height - event->y) * scale);
+	}
+
 	return FALSE;
 }
 
 static gboolean
 on_button_release (GtkWidget *widget, GdkEventButton *event)
 {
+	TRACE_FUNC();
+
 	if (event->button == 1)
 		panning = FALSE;
 
@@ -110,6 +390,8 @@ on_button_release (GtkWidget *widget, GdkEventButton *event)
 static gboolean
 on_motion_notify (GtkWidget *widget, GdkEventMotion *event)
 {
+	TRACE_FUNC();
+
 	GtkAllocation allocation;
 	gtk_widget_get_allocation(widget, &allocation);
 
@@ -122,6 +404,8 @@ on_motion_notify (GtkWidget *widget, GdkEventMotion *event)
 static gboolean
 on_scroll (GtkWidget* widget, GdkEventScroll *event)
 {
+	TRACE_FUNC();
+
 	switch (event->direction)
 	{
 	case GDK_SCROLL_UP:
@@ -162,46 +446,222 @@ static void
 connect_glarea_signals (GtkWidget *glarea)
 {
 	struct signal signals[] = {
+#ifdef DEBUG
+		{ "create-context",		G_CALLBACK(on_create_context),	0			},
+#endif
 		{ "realize",			G_CALLBACK(on_realize),		0			},
+		{ "unrealize",			G_CALLBACK(on_unrealize),	0			},
 		{ "render",			G_CALLBACK(on_render),		0			},
 		{ "resize",			G_CALLBACK(on_resize),		0			},
+	};
+
+	connect_signals(glarea, signals, NELEM(signals));
+}
+
+#ifdef GDK_WINDOWING_X11
+
+static void
+connect_surface_signals (GtkWidget *area)
+{
+	struct signal signals[] = {
+		{ "realize",			G_CALLBACK(on_surface_realize),		0	},
+		{ "unrealize",			G_CALLBACK(on_surface_unrealize),	0	},
+		{ "size-allocate",		G_CALLBACK(on_surface_size_allocate),	0	},
+	};
+
+	connect_signals(area, signals, NELEM(signals));
+}
+
+#endif
+
+static void
+connect_input_signals (GtkWidget *area)
+{
+	struct signal signals[] = {
 		{ "scroll-event",		G_CALLBACK(on_scroll),		GDK_SCROLL_MASK		},
 		{ "button-press-event",		G_CALLBACK(on_button_press),	GDK_BUTTON_PRESS_MASK	},
 		{ "button-release-event",	G_CALLBACK(on_button_release),	GDK_BUTTON_RELEASE_MASK	},
 		{ "motion-notify-event",	G_CALLBACK(on_motion_notify),	GDK_BUTTON1_MOTION_MASK	},
 	};
 
-	connect_signals(glarea, signals, NELEM(signals));
+	connect_signals(area, signals, NELEM(signals));
 }
 
 bool
 gui_init (int *argc, char ***argv)
 {
+	GError *error = NULL;
+	gchar *shape = NULL;
+	gint triangles = 12;
+	gboolean mesh_stats = FALSE;
+	gint objects = 0;
+	gchar *animate = NULL;
+	gchar *pick = NULL;
+	gint materials = 0;
+	gchar *textures = NULL;
+	gchar *assets = NULL;
+	gchar *present = NULL;
+	gint lights = 0;
+	enum mesh_shape mesh_shape = MESH_CUBE;
+	enum animate_mode animate_mode = ANIMATE_CPU;
+	enum material_mode material_mode = MATERIAL_ARRAY;
+
+	GOptionEntry entries[] = {
+		{ "shape",	's', 0, G_OPTION_ARG_STRING,	&shape,		"Model shape: cube, sphere or grid",	"SHAPE"	},
+		{ "triangles",	't', 0, G_OPTION_ARG_INT,	&triangles,	"Minimum number of model triangles",	"N"	},
+		{ "mesh-stats",	0,   0, G_OPTION_ARG_NONE,	&mesh_stats,	"Print the model's generation time",	NULL	},
+		{ "objects",	'o', 0, G_OPTION_ARG_INT,	&objects,	"Number of animated objects",		"N"	},
+		{ "animate",	'a', 0, G_OPTION_ARG_STRING,	&animate,	"Animate objects on the cpu or gpu",	"WHERE"	},
+		{ "pick",	'p', 0, G_OPTION_ARG_STRING,	&pick,		"Pick objects on the cpu or gpu",	"WHERE"	},
+		{ "materials",	'm', 0, G_OPTION_ARG_INT,	&materials,	"Number of object materials",		"N"	},
+		{ "textures",	'x', 0, G_OPTION_ARG_STRING,	&textures,	"Material textures: array or separate",	"MODE"	},
+		{ "lights",	'l', 0, G_OPTION_ARG_INT,	&lights,	"Number of point lights",		"N"	},
+		{ "bloom",	'b', 0, G_OPTION_ARG_INT,	&bloom,		"Add a bloom with N blur passes",	"N"	},
+		{ "assets",	'A', 0, G_OPTION_ARG_FILENAME,	&assets,	"Load assets from a pack file",		"FILE"	},
+		{ "present",	'P', 0, G_OPTION_ARG_STRING,	&present,	"Present through the area or egl",	"HOW"	},
+		{ "swap-interval", 'i', 0, G_OPTION_ARG_INT,	&swap_interval,	"Frames per swap with --present egl",	"N"	},
+		{ NULL },
+	};
+
 	// Initialize GTK:
-	if (!gtk_init_check(argc, argv)) {
-		fputs("Could not initialize GTK", stderr);
+	if (!gtk_init_with_args(argc, argv, NULL, entries, NULL, &error)) {
+		fprintf(stderr, "Could not initialize GTK: %s\n", error ? error->message : "no display");
+		g_clear_error(&error);
+		return false;
+	}
+
+	if (shape != NULL && !mesh_shape_parse(shape, &mesh_shape)) {
+		fprintf(stderr, "Unknown shape: %s\n", shape);
+		g_free(shape);
 		return false;
 	}
 
+	g_free(shape);
+
+	if (animate != NULL && !animate_mode_parse(animate, &animate_mode)) {
+		fprintf(stderr, "Unknown animation mode: %s\n", animate);
+		g_free(animate);
+		return false;
+	}
+
+	g_free(animate);
+
+	if (pick != NULL && !pick_backend_parse(pick, &pick_backend)) {
+		fprintf(stderr, "Unknown picking backend: %s\n", pick);
+		g_free(pick);
+		return false;
+	}
+
+	g_free(pick);
+
+	if (textures != NULL && !material_mode_parse(textures, &material_mode)) {
+		fprintf(stderr, "Unknown texture mode: %s\n", textures);
+		g_free(textures);
+		return false;
+	}
+
+	g_free(textures);
+
+	if (present != NULL && !present_backend_parse(present, &present_backend)) {
+		fprintf(stderr, "Unknown presentation backend: %s\n", present);
+		g_free(present);
+		return false;
+	}
+
+	g_free(present);
+
+#ifdef GDK_WINDOWING_X11
+	if (present_backend == PRESENT_EGL && !GDK_IS_X11_DISPLAY(gdk_display_get_default())) {
+#else
+	if (present_backend == PRESENT_EGL) {
+#endif
+		fputs("Presenting through EGL needs an X11 display; using the area\n", stderr);
+		present_backend = PRESENT_AREA;
+	}
+
+	// Map the external asset pack, if any:
+	if (assets != NULL && !pack_open(assets)) {
+		g_free(assets);
+		return false;
+	}
+
+	g_free(assets);
+
+	if (swap_interval < 0) {
+		fputs("Swap interval must not be negative\n", stderr);
+		return false;
+	}
+
+	if (bloom < 0) {
+		fputs("Number of blur passes must not be negative\n", stderr);
+		return false;
+	}
+
+	if (lights < 0) {
+		fputs("Number of lights must not be negative\n", stderr);
+		return false;
+	}
+
+	if (materials < 0) {
+		fputs("Number of materials must not be negative\n", stderr);
+		return false;
+	}
+
+	if (objects < 0) {
+		fputs("Number of objects must not be negative\n", stderr);
+		return false;
+	}
+
+	if (triangles < 1) {
+		fputs("Number of triangles must be positive\n", stderr);
+		return false;
+	}
+
+	model_set_scene(mesh_shape, triangles, mesh_stats);
+	model_set_materials(materials, material_mode);
+	model_set_lights(lights);
+	model_set_objects(objects, animate_mode);
 	return true;
 }
 
 bool
 gui_run (void)
 {
-	// Create toplevel window, add GtkGLArea:
 	GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
-	GtkWidget *glarea = gtk_gl_area_new();
-	gtk_container_add(GTK_CONTAINER(window), glarea);
+	GtkWidget *area;
 
-	// Connect GTK signals:
 	connect_window_signals(window);
-	connect_glarea_signals(glarea);
+
+#ifdef GDK_WINDOWING_X11
+	if (present_backend == PRESENT_EGL) {
+
+		// Add a drawing area that GDK leaves alone, so that EGL can
+		// own its window:
+		area = gtk_drawing_area_new();
+		gtk_widget_set_app_paintable(area, TRUE);
+		G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+		gtk_widget_set_double_buffered(area, FALSE);
+		G_GNUC_END_IGNORE_DEPRECATIONS
+		connect_surface_signals(area);
+	}
+	else
+#endif
+	{
+		// Add GtkGLArea:
+		area = gtk_gl_area_new();
+		connect_glarea_signals(area);
+	}
+
+	connect_input_signals(area);
+	gtk_container_add(GTK_CONTAINER(window), area);
 
 	gtk_widget_show_all(window);
 
 	// Enter GTK event loop:
 	gtk_main();
 
+	// Everything should have been deleted on unrealize:
+	resource_leaks();
+
 	return true;
 }
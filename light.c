@@ -0,0 +1,347 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <GL/gl.h>
+
+#include "debug.h"
+#include "extension.h"
+#include "light.h"
+#include "program.h"
+#include "resource.h"
+#include "stats.h"
+#include "trace.h"
+#include "util.h"
+#include "view.h"
+
+// Number of clusters along x, y and z; slices are spaced exponentially in
+// depth, so that clusters stay roughly cubic:
+#define CLUSTER_X	16
+#define CLUSTER_Y	16
+#define CLUSTER_Z	24
+#define CLUSTERS	(CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+
+// Light, laid out as in the fragment shader:
+struct light {
+	float pos[3];
+	float radius;
+	float color[4];
+};
+
+// Circular path of a light around the y axis:
+struct orbit {
+	float distance;
+	float height;
+	float speed;
+	float phase;
+};
+
+enum {
+	SSBO_LIGHTS,
+	SSBO_CLUSTERS,
+	SSBO_INDICES,
+};
+
+static struct {
+	size_t			 count;
+	bool			 clustered;
+	float			 time;
+	struct light		*lights;
+	struct orbit		*orbits;
+	uint32_t		 clusters[CLUSTERS][2];
+	uint32_t		*indices;
+	size_t			 nindices;
+	size_t			 aindices;
+	GLuint			 ssbo[3];
+	struct light_stats	 stats;
+} state;
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float
+random_range (float min, float max)
+{
+	return min + (max - min) * rand() / (float) RAND_MAX;
+}
+
+static void
+upload (GLuint buffer, const void *data, size_t size)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+
+	// Orphan the old storage rather than wait for the GPU to finish with it:
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_STREAM_DRAW);
+	DEBUG_UPLOAD(buffer, 0, data, size);
+	resource_size(RESOURCE_BUFFER, buffer, size);
+}
+
+// Create the given number of point lights, each circling the objects at its
+// own distance, height and speed:
+bool
+light_init (size_t count)
+{
+	TRACE_FUNC();
+
+	// Shader storage buffers need OpenGL 4.3:
+	if (!extension_version(430) || !program_light_available()) {
+		fputs("Lighting needs OpenGL 4.3\n", stderr);
+		return false;
+	}
+
+	state.count     = count;
+	state.clustered = true;
+	state.lights    = calloc(count, sizeof(struct light));
+	state.orbits    = calloc(count, sizeof(struct orbit));
+
+	srand(2);
+
+	for (size_t i = 0; i < count; i++) {
+		struct light *l = &state.lights[i];
+
+		state.orbits[i] = (struct orbit) {
+			.distance = random_range(0.1f, 0.8f),
+			.height   = random_range(-0.6f, 0.6f),
+			.speed    = random_range(-0.02f, 0.02f),
+			.phase    = random_range(0.0f, 2 * M_PI),
+		};
+
+		l->radius = random_range(0.15f, 0.35f);
+
+		// Saturated colors, dimmer as there are more lights:
+		for (int c = 0; c < 3; c++)
+			l->color[c] = random_range(0.2f, 1.0f) * fminf(1.0f, 8.0f / sqrtf(count));
+	}
+
+	FOREACH (state.ssbo, b)
+		*b = resource_create(RESOURCE_BUFFER, "light");
+
+	// Give the cluster buffers storage even when all lights are
+	// evaluated per fragment:
+	upload(state.ssbo[SSBO_CLUSTERS], state.clusters, sizeof(state.clusters));
+	upload(state.ssbo[SSBO_INDICES], state.clusters, sizeof(uint32_t));
+
+	memset(&state.stats, 0, sizeof(state.stats));
+	return true;
+}
+
+// Evaluate all lights per fragment instead of only those in its cluster,
+// for comparison:
+void
+light_set_clustered (bool clustered)
+{
+	state.clustered = clustered;
+}
+
+static void
+move_lights (void)
+{
+	state.time += 1.0f;
+
+	for (size_t i = 0; i < state.count; i++) {
+		const struct orbit *o = &state.orbits[i];
+		float angle = o->phase + o->speed * state.time;
+
+		state.lights[i].pos[0] = o->distance * cosf(angle);
+		state.lights[i].pos[1] = o->height;
+		state.lights[i].pos[2] = o->distance * sinf(angle);
+	}
+}
+
+static int
+slice_of (const struct view_frustum *f, float z)
+{
+	int k = floorf(logf(z / f->near) / logf(f->far / f->near) * CLUSTER_Z);
+
+	return k < 0 ? 0 : k >= CLUSTER_Z ? CLUSTER_Z - 1 : k;
+}
+
+// Get the range of tiles covered by an interval [lo, hi] on the near plane
+// of unit distance, scaled by the frustum's tangent:
+static bool
+tile_range (float lo, float hi, float tan, int tiles, int *first, int *last)
+{
+	float a = (lo / tan + 1) / 2 * tiles;
+	float b = (hi / tan + 1) / 2 * tiles;
+
+	if (b < 0 || a >= tiles)
+		return false;
+
+	*first = a < 0 ? 0 : (int) a;
+	*last  = b >= tiles ? tiles - 1 : (int) b;
+	return true;
+}
+
+// Visit each cluster that a light's bounding sphere may touch. In view
+// space, x / z is monotonic in z, so the extent over a slice's depth is
+// found at its nearest and farthest depth:
+static void
+visit_clusters (const struct view_frustum *f, uint32_t index, bool fill)
+{
+	const struct light *l = &state.lights[index];
+	float x = l->pos[0], y = l->pos[1], z = l->pos[2] + f->eye_z, r = l->radius;
+
+	if (z + r < f->near || z - r > f->far)
+		return;
+
+	int k0 = slice_of(f, fmaxf(z - r, f->near));
+	int k1 = slice_of(f, fminf(z + r, f->far));
+
+	for (int k = k0; k <= k1; k++) {
+		float zlo = f->near * powf(f->far / f->near, (float) k / CLUSTER_Z);
+		float zhi = f->near * powf(f->far / f->near, (float) (k + 1) / CLUSTER_Z);
+		int x0, x1, y0, y1;
+
+		zlo = fmaxf(zlo, z - r);
+		zhi = fminf(zhi, z + r);
+
+		float xlo = fminf((x - r) / zlo, (x - r) / zhi);
+		float xhi = fmaxf((x + r) / zlo, (x + r) / zhi);
+		float ylo = fminf((y - r) / zlo, (y - r) / zhi);
+		float yhi = fmaxf((y + r) / zlo, (y + r) / zhi);
+
+		if (!tile_range(xlo, xhi, f->tan_x, CLUSTER_X, &x0, &x1)
+		 || !tile_range(ylo, yhi, f->tan_y, CLUSTER_Y, &y0, &y1))
+			continue;
+
+		for (int ty = y0; ty <= y1; ty++)
+			for (int tx = x0; tx <= x1; tx++) {
+				uint32_t *c = state.clusters[(k * CLUSTER_Y + ty) * CLUSTER_X + tx];
+
+				if (fill)
+					state.indices[c[0] + c[1]] = index;
+
+				c[1]++;
+			}
+	}
+}
+
+// Bin the lights into clusters in two passes: count the lights per
+// cluster, then lay out the clusters' index lists back to back and fill
+// them in:
+static void
+bin_lights (void)
+{
+	struct view_frustum f;
+	size_t total = 0, max = 0;
+
+	view_frustum(&f);
+	memset(state.clusters, 0, sizeof(state.clusters));
+
+	for (size_t i = 0; i < state.count; i++)
+		visit_clusters(&f, i, false);
+
+	for (size_t c = 0; c < CLUSTERS; c++) {
+		if (state.clusters[c][1] > max)
+			max = state.clusters[c][1];
+
+		state.clusters[c][0] = total;
+		total += state.clusters[c][1];
+		state.clusters[c][1] = 0;
+	}
+
+	if (total > state.aindices) {
+		free(state.indices);
+		state.aindices = total * 2;
+		state.indices  = malloc(state.aindices * sizeof(uint32_t));
+	}
+
+	for (size_t i = 0; i < state.count; i++)
+		visit_clusters(&f, i, true);
+
+	state.nindices          = total;
+	state.stats.indices     = total;
+	state.stats.max_cluster = max;
+}
+
+// Move the lights, bin them into clusters and upload the result:
+void
+light_update (void)
+{
+	TRACE_FUNC();
+
+	double start = now();
+
+	move_lights();
+
+	if (state.clustered)
+		bin_lights();
+
+	state.stats.bin_seconds += now() - start;
+	state.stats.updates++;
+
+	upload(state.ssbo[SSBO_LIGHTS], state.lights, state.count * sizeof(struct light));
+
+	if (state.clustered) {
+		upload(state.ssbo[SSBO_CLUSTERS], state.clusters, sizeof(state.clusters));
+
+		// Buffers can't be empty:
+		upload(state.ssbo[SSBO_INDICES], state.indices,
+			(state.nindices ? state.nindices : 1) * sizeof(uint32_t));
+	}
+}
+
+// Bind the light buffers and set the cluster parameters, after
+// program_light_use():
+void
+light_bind (void)
+{
+	struct view_frustum f;
+	float width, height;
+
+	view_frustum(&f);
+	view_window_size(&width, &height);
+
+	FOREACH (state.ssbo, b)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3 + (b - state.ssbo), *b);
+
+	glUniform3ui(program_light_loc(LOC_LIGHT_CLUSTER_DIMS), CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+	glUniform2f(program_light_loc(LOC_LIGHT_VIEWPORT), width, height);
+	glUniform1f(program_light_loc(LOC_LIGHT_NEAR), f.near);
+	glUniform1f(program_light_loc(LOC_LIGHT_FAR), f.far);
+	glUniform1f(program_light_loc(LOC_LIGHT_EYE_Z), f.eye_z);
+	glUniform1i(program_light_loc(LOC_LIGHT_CLUSTERED), state.clustered);
+	glUniform1ui(program_light_loc(LOC_LIGHT_COUNT), state.count);
+
+	stats_count(STAT_BUFFERS, NELEM(state.ssbo));
+	stats_count(STAT_UNIFORMS, 7);
+}
+
+size_t
+light_count (void)
+{
+	return state.count;
+}
+
+void
+light_stats (struct light_stats *stats)
+{
+	*stats = state.stats;
+}
+
+void
+light_destroy (void)
+{
+	if (state.count == 0)
+		return;
+
+	FOREACH (state.ssbo, b)
+		resource_delete(RESOURCE_BUFFER, *b);
+
+	free(state.lights);
+	free(state.orbits);
+	free(state.indices);
+
+	memset(&state, 0, sizeof(state));
+}
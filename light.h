@@ -0,0 +1,18 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+// Accumulated over all updates since light_init():
+struct light_stats {
+	size_t	updates;
+	double	bin_seconds;
+	size_t	indices;	// In the last update
+	size_t	max_cluster;	// Most lights in one cluster, last update
+};
+
+bool light_init (size_t count);
+void light_set_clustered (bool clustered);
+void light_update (void);
+void light_bind (void);
+size_t light_count (void);
+void light_stats (struct light_stats *stats);
+void light_destroy (void);
@@ -0,0 +1,203 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+// A small LZ77 codec in the LZ4 block format: a sequence of literal runs,
+// each followed by a copy from up to 64 KiB back. Every sequence starts
+// with a token holding four bits of literal length and four bits of match
+// length, either of which continues in extra bytes when it is all ones.
+
+#define HASH_BITS	12
+#define MIN_MATCH	4
+
+// The format requires the last five bytes to be literals, and the last
+// match to start at least twelve bytes before the end:
+#define LAST_LITERALS	5
+#define MATCH_MARGIN	12
+
+static uint32_t
+read32 (const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static uint32_t
+hash (uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Output position and end:
+struct out {
+	uint8_t	*p;
+	uint8_t	*end;
+};
+
+static bool
+put_length (struct out *o, size_t n)
+{
+	for (; n >= 255; n -= 255) {
+		if (o->p == o->end)
+			return false;
+
+		*o->p++ = 255;
+	}
+
+	if (o->p == o->end)
+		return false;
+
+	*o->p++ = n;
+	return true;
+}
+
+// Write one sequence. A zero match length marks the final literals:
+static bool
+put_sequence (struct out *o, const uint8_t *lit, size_t nlit, size_t offset, size_t mlen)
+{
+	size_t m = mlen ? mlen - MIN_MATCH : 0;
+
+	if (o->p == o->end)
+		return false;
+
+	*o->p++ = (nlit < 15 ? nlit : 15) << 4 | (m < 15 ? m : 15);
+
+	if (nlit >= 15 && !put_length(o, nlit - 15))
+		return false;
+
+	if ((size_t) (o->end - o->p) < nlit)
+		return false;
+
+	memcpy(o->p, lit, nlit);
+	o->p += nlit;
+
+	if (mlen == 0)
+		return true;
+
+	if (o->end - o->p < 2)
+		return false;
+
+	*o->p++ = offset & 0xFF;
+	*o->p++ = offset >> 8;
+
+	return m < 15 || put_length(o, m - 15);
+}
+
+// Compress into the given buffer. Returns the compressed size, or zero if
+// it does not fit:
+size_t
+lz_compress (const uint8_t *src, size_t len, uint8_t *dst, size_t cap)
+{
+	uint32_t table[1 << HASH_BITS] = { 0 };
+	struct out o = { dst, dst + cap };
+	size_t ip = 0, anchor = 0;
+
+	if (len > MATCH_MARGIN) {
+		size_t limit = len - MATCH_MARGIN;
+		size_t match_limit = len - LAST_LITERALS;
+
+		while (ip < limit) {
+			uint32_t seq = read32(src + ip);
+			uint32_t h = hash(seq);
+			size_t ref = table[h];
+
+			table[h] = ip;
+
+			if (ref >= ip || ip - ref > 0xFFFF || read32(src + ref) != seq) {
+				ip++;
+				continue;
+			}
+
+			size_t mlen = MIN_MATCH;
+
+			while (ip + mlen < match_limit && src[ref + mlen] == src[ip + mlen])
+				mlen++;
+
+			if (!put_sequence(&o, src + anchor, ip - anchor, ip - ref, mlen))
+				return 0;
+
+			ip += mlen;
+			anchor = ip;
+		}
+	}
+
+	if (!put_sequence(&o, src + anchor, len - anchor, 0, 0))
+		return 0;
+
+	return o.p - dst;
+}
+
+static bool
+get_length (const uint8_t **p, const uint8_t *end, size_t *n)
+{
+	uint8_t b;
+
+	do {
+		if (*p == end)
+			return false;
+
+		b = *(*p)++;
+		*n += b;
+	}
+	while (b == 255);
+
+	return true;
+}
+
+// Decompress into a buffer of exactly the original size. Fails on corrupt
+// input rather than reading or writing out of bounds:
+bool
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst, size_t raw)
+{
+	const uint8_t *ip = src, *end = src + len;
+	uint8_t *op = dst, *oend = dst + raw;
+
+	while (ip < end) {
+		uint8_t token = *ip++;
+		size_t nlit = token >> 4;
+
+		if (nlit == 15 && !get_length(&ip, end, &nlit))
+			return false;
+
+		if ((size_t) (end - ip) < nlit || (size_t) (oend - op) < nlit)
+			return false;
+
+		memcpy(op, ip, nlit);
+		ip += nlit;
+		op += nlit;
+
+		// The last sequence has no match:
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			return false;
+
+		size_t offset = ip[0] | ip[1] << 8;
+		size_t mlen = token & 15;
+
+		ip += 2;
+
+		if (offset == 0 || offset > (size_t) (op - dst))
+			return false;
+
+		if (mlen == 15 && !get_length(&ip, end, &mlen))
+			return false;
+
+		mlen += MIN_MATCH;
+
+		if ((size_t) (oend - op) < mlen)
+			return false;
+
+		// Byte by byte, since the copy may overlap itself:
+		for (const uint8_t *ref = op - offset; mlen > 0; mlen--)
+			*op++ = *ref++;
+	}
+
+	return op == oend;
+}
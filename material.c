@@ -0,0 +1,260 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+
+#include "material.h"
+#include "resource.h"
+#include "stats.h"
+#include "trace.h"
+#include "util.h"
+
+// Size of each material texture:
+#define SIZE	64
+
+static struct {
+	enum material_mode	 mode;
+	size_t			 count;
+	size_t			 objects;
+	GLuint			 ssbo;
+	GLuint			 array;
+	GLuint			*separate;
+	uint32_t		*material;
+} state;
+
+static const char *modes[] = {
+	[MATERIAL_ARRAY]    = "array",
+	[MATERIAL_SEPARATE] = "separate",
+};
+
+bool
+material_mode_parse (const char *name, enum material_mode *mode)
+{
+	FOREACH (modes, m)
+		if (strcmp(*m, name) == 0) {
+			*mode = m - modes;
+			return true;
+		}
+
+	return false;
+}
+
+const char *
+material_mode_name (enum material_mode mode)
+{
+	return modes[mode];
+}
+
+// Draw the pattern of a material: checkers, stripes or dots, in a hue that
+// cycles with the material index:
+static void
+make_pattern (uint8_t *rgba, size_t index)
+{
+	static const uint8_t hue[6][3] = {
+		{ 255, 128, 128 },
+		{ 128, 255, 128 },
+		{ 128, 128, 255 },
+		{ 255, 255, 128 },
+		{ 128, 255, 255 },
+		{ 255, 128, 255 },
+	};
+
+	const uint8_t *c = hue[index % 6];
+	int scale = 4 << (index / 18 % 3);
+
+	for (int y = 0; y < SIZE; y++)
+		for (int x = 0; x < SIZE; x++, rgba += 4) {
+			bool on;
+
+			switch (index / 6 % 3)
+			{
+			case 0:
+				on = ((x / scale) ^ (y / scale)) & 1;
+				break;
+
+			case 1:
+				on = ((x + y) / scale) & 1;
+				break;
+
+			default: {
+				int dx = x % (scale * 2) - scale;
+				int dy = y % (scale * 2) - scale;
+				on = dx * dx + dy * dy < scale * scale / 2;
+				break;
+			}
+			}
+
+			for (int i = 0; i < 3; i++)
+				rgba[i] = on ? c[i] : 255;
+
+			rgba[3] = 255;
+		}
+}
+
+// Draw the patterns of the given number of materials into consecutive
+// layers; free the result when done:
+static uint8_t *
+make_patterns (size_t count)
+{
+	size_t layer = SIZE * SIZE * 4;
+	uint8_t *pixels = malloc(count * layer);
+
+	if (pixels == NULL)
+		return NULL;
+
+	for (size_t i = 0; i < count; i++)
+		make_pattern(pixels + i * layer, i);
+
+	return pixels;
+}
+
+// Create a mipmapped texture array from the given layers:
+static GLuint
+create_array (const uint8_t *pixels, size_t layers)
+{
+	GLuint id = resource_create(RESOURCE_TEXTURE, "material");
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, SIZE, SIZE, layers, 0,
+		GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+	// The mipmap chain adds a third:
+	resource_size(RESOURCE_TEXTURE, id, SIZE * SIZE * 4 * layers * 4 / 3);
+
+	return id;
+}
+
+// Create a texture array with the given number of materials as its layers:
+GLuint
+material_create_array (size_t count)
+{
+	uint8_t *pixels = make_patterns(count);
+
+	if (pixels == NULL)
+		return 0;
+
+	GLuint id = create_array(pixels, count);
+
+	free(pixels);
+	return id;
+}
+
+// Give each of the objects one of the given number of materials. The array
+// mode packs all materials into the layers of one texture, so that objects
+// can be drawn in one call; the separate mode gives each material its own
+// texture, to be bound before drawing each object:
+bool
+material_init (size_t objects, size_t count, enum material_mode mode)
+{
+	TRACE_FUNC();
+
+	GLint max_layers;
+	size_t layer = SIZE * SIZE * 4;
+
+	glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &max_layers);
+
+	if (count > (size_t) max_layers) {
+		fprintf(stderr, "At most %d materials are supported\n", max_layers);
+		return false;
+	}
+
+	uint8_t *pixels = make_patterns(count);
+
+	if (pixels == NULL)
+		return false;
+
+	uint32_t *material = malloc(objects * sizeof(uint32_t));
+	GLuint *separate = mode == MATERIAL_SEPARATE ? malloc(count * sizeof(GLuint)) : NULL;
+
+	if (material == NULL || (mode == MATERIAL_SEPARATE && separate == NULL)) {
+		fputs("Could not allocate the materials\n", stderr);
+		free(separate);
+		free(material);
+		free(pixels);
+		return false;
+	}
+
+	state.mode     = mode;
+	state.count    = count;
+	state.objects  = objects;
+	state.material = material;
+	state.separate = separate;
+
+	// Neighbouring objects get different materials:
+	for (size_t i = 0; i < objects; i++)
+		state.material[i] = i % count;
+
+	if (mode == MATERIAL_ARRAY)
+		state.array = create_array(pixels, count);
+	else {
+		// Single-layer arrays share the shader with the array mode;
+		// the layer index is clamped to the one layer there is:
+		for (size_t i = 0; i < count; i++)
+			state.separate[i] = create_array(pixels + i * layer, 1);
+	}
+
+	free(pixels);
+
+	state.ssbo = resource_create(RESOURCE_BUFFER, "material");
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, state.ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, objects * sizeof(uint32_t),
+		state.material, GL_STATIC_DRAW);
+	resource_size(RESOURCE_BUFFER, state.ssbo, objects * sizeof(uint32_t));
+
+	return true;
+}
+
+// Bind the textures for drawing the given object, and the per-object
+// material layers. In array mode, this holds for all objects:
+void
+material_bind (size_t object)
+{
+	GLuint texture = state.mode == MATERIAL_ARRAY
+		? state.array
+		: state.separate[state.material[object]];
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, state.ssbo);
+
+	stats_count(STAT_TEXTURES, 1);
+	stats_count(STAT_BUFFERS, 1);
+}
+
+size_t
+material_count (void)
+{
+	return state.count;
+}
+
+enum material_mode
+material_mode (void)
+{
+	return state.mode;
+}
+
+void
+material_destroy (void)
+{
+	if (state.count == 0)
+		return;
+
+	if (state.mode == MATERIAL_ARRAY)
+		resource_delete(RESOURCE_TEXTURE, state.array);
+	else
+		FOREACH_NELEM (state.separate, state.count, t)
+			resource_delete(RESOURCE_TEXTURE, *t);
+
+	resource_delete(RESOURCE_BUFFER, state.ssbo);
+
+	free(state.separate);
+	free(state.material);
+
+	memset(&state, 0, sizeof(state));
+}
@@ -0,0 +1,16 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+enum material_mode {
+	MATERIAL_ARRAY,
+	MATERIAL_SEPARATE,
+};
+
+bool material_mode_parse (const char *name, enum material_mode *mode);
+const char *material_mode_name (enum material_mode mode);
+bool material_init (size_t objects, size_t count, enum material_mode mode);
+void material_bind (size_t object);
+size_t material_count (void);
+enum material_mode material_mode (void);
+void material_destroy (void);
+GLuint material_create_array (size_t count);
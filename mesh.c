@@ -0,0 +1,332 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "mesh.h"
+#include "trace.h"
+#include "util.h"
+#include "vertex.h"
+
+// Smallest mesh whose cost is extrapolated to a million triangles:
+#define MIN_REPORT_TRIANGLES	100000
+
+// Each corner point has a position and a color:
+struct corner {
+	struct point pos;
+	struct color color;
+};
+
+// The unit cube is made of six faces of four corners each. Corners 0 and 1
+// are opposite each other, as are corners 2 and 3:
+static const struct point cube[6][4] =
+{ { { 0, 1, 0 }
+  , { 1, 0, 0 }
+  , { 0, 0, 0 }
+  , { 1, 1, 0 }
+  }
+, { { 0, 0, 0 }
+  , { 1, 0, 1 }
+  , { 0, 0, 1 }
+  , { 1, 0, 0 }
+  }
+, { { 1, 0, 0 }
+  , { 1, 1, 1 }
+  , { 1, 0, 1 }
+  , { 1, 1, 0 }
+  }
+, { { 1, 1, 0 }
+  , { 0, 1, 1 }
+  , { 1, 1, 1 }
+  , { 0, 1, 0 }
+  }
+, { { 0, 1, 0 }
+  , { 0, 0, 1 }
+  , { 0, 1, 1 }
+  , { 0, 0, 0 }
+  }
+, { { 0, 1, 1 }
+  , { 1, 0, 1 }
+  , { 1, 1, 1 }
+  , { 0, 0, 1 }
+  }
+} ;
+
+static const struct {
+	const char	*name;
+	int		 faces;
+}
+shapes[] = {
+	[MESH_CUBE]   = { "cube",   6 },
+	[MESH_SPHERE] = { "sphere", 6 },
+	[MESH_GRID]   = { "grid",   1 },
+};
+
+// A range of rows of quads to generate, one per thread:
+struct job {
+	struct mesh	*mesh;
+	int		 n;
+	int		 row_begin;
+	int		 row_end;
+	pthread_t	 thread;
+	bool		 started;
+};
+
+// Return the cross product of two vectors:
+static void
+cross (struct point *result, const struct point *a, const struct point *b)
+{
+	result->x = a->y * b->z - a->z * b->y;
+	result->y = a->z * b->x - a->x * b->z;
+	result->z = a->x * b->y - a->y * b->x;
+}
+
+static void
+normalize (struct point *p, float length)
+{
+	float d = sqrtf(p->x * p->x + p->y * p->y + p->z * p->z) / length;
+
+	p->x /= d;
+	p->y /= d;
+	p->z /= d;
+}
+
+// Get the point at (s, t) on a face, spanned from corner 2 towards corners
+// 1 and 0:
+static struct point
+face_point (const struct point *face, float s, float t)
+{
+	return (struct point) {
+		.x = face[2].x + s * (face[1].x - face[2].x) + t * (face[0].x - face[2].x),
+		.y = face[2].y + s * (face[1].y - face[2].y) + t * (face[0].y - face[2].y),
+		.z = face[2].z + s * (face[1].z - face[2].z) + t * (face[0].z - face[2].z),
+	};
+}
+
+static void
+make_corner (struct corner *corner, enum mesh_shape shape, struct point pos, float s, float t)
+{
+	// Color is based on the position on the unit cube:
+	corner->color.r = pos.x * 0.8f + 0.1f;
+	corner->color.g = pos.y * 0.8f + 0.1f;
+	corner->color.b = pos.z * 0.8f + 0.1f;
+
+	// Center on the origin:
+	pos.x -= 0.5f;
+	pos.y -= 0.5f;
+	pos.z -= 0.5f;
+
+	switch (shape)
+	{
+	case MESH_SPHERE:
+		normalize(&pos, 0.5f);
+		break;
+
+	case MESH_GRID:
+		pos.z += 0.05f * sinf(s * 8 * M_PI) * sinf(t * 8 * M_PI);
+		break;
+
+	default:
+		break;
+	}
+
+	corner->pos = pos;
+}
+
+// Generate one quad of two triangles at the given vertex pointer:
+static void
+make_quad (struct vertex *vertex, enum mesh_shape shape, const struct point *face, int n, int i, int j)
+{
+	struct corner corner[4];
+	struct point normal;
+
+	float s0 = (float) i / n, s1 = (float) (i + 1) / n;
+	float t0 = (float) j / n, t1 = (float) (j + 1) / n;
+
+	make_corner(&corner[0], shape, face_point(face, s0, t1), s0, t1);
+	make_corner(&corner[1], shape, face_point(face, s1, t0), s1, t0);
+	make_corner(&corner[2], shape, face_point(face, s0, t0), s0, t0);
+	make_corner(&corner[3], shape, face_point(face, s1, t1), s1, t1);
+
+	// First rib is (corner 3 - corner 0):
+	struct point a = {
+		.x = corner[3].pos.x - corner[0].pos.x,
+		.y = corner[3].pos.y - corner[0].pos.y,
+		.z = corner[3].pos.z - corner[0].pos.z,
+	};
+
+	// Second rib is (corner 2 - corner 0):
+	struct point b = {
+		.x = corner[2].pos.x - corner[0].pos.x,
+		.y = corner[2].pos.y - corner[0].pos.y,
+		.z = corner[2].pos.z - corner[0].pos.z,
+	};
+
+	// Face normal is cross product of these two ribs,
+	// scaled to unit length since the ribs shrink with n:
+	cross(&normal, &a, &b);
+	normalize(&normal, 1.0f);
+
+	// Corners to compose triangles of, chosen in
+	// such a way that both triangles rotate CCW:
+	int index[2][3] = { { 0, 2, 1 }, { 1, 3, 0 } };
+
+	for (int t = 0; t < 2; t++) {
+		for (int v = 0; v < 3; v++) {
+			const struct corner *c = &corner[index[t][v]];
+
+			vertex->pos    = c->pos;
+			vertex->normal = normal;
+			vertex->color  = c->color;
+			vertex++;
+		}
+	}
+}
+
+static void *
+run_job (void *data)
+{
+	struct job *job = data;
+	struct mesh *mesh = job->mesh;
+	int n = job->n;
+
+	TRACE_SCOPE("mesh_job");
+
+	// Rows are numbered consecutively across faces, and each row
+	// has a fixed place in the output:
+	for (int row = job->row_begin; row < job->row_end; row++) {
+		const struct point *face = cube[row / n];
+		struct vertex *vertex = mesh->vert + (size_t) row * n * 6;
+
+		for (int i = 0; i < n; i++, vertex += 6)
+			make_quad(vertex, mesh->shape, face, n, i, row % n);
+	}
+
+	return NULL;
+}
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+bool
+mesh_shape_parse (const char *name, enum mesh_shape *shape)
+{
+	FOREACH (shapes, s)
+		if (strcmp(s->name, name) == 0) {
+			*shape = s - shapes;
+			return true;
+		}
+
+	return false;
+}
+
+const char *
+mesh_shape_name (enum mesh_shape shape)
+{
+	return shapes[shape].name;
+}
+
+// Generate a shape of at least the given number of triangles, by dividing
+// each face into n * n quads. Zero threads means one per CPU:
+bool
+mesh_generate (struct mesh *mesh, enum mesh_shape shape, size_t triangles, int threads)
+{
+	TRACE_FUNC();
+
+	int faces = shapes[shape].faces;
+	int n = ceil(sqrt(triangles / (faces * 2.0)));
+
+	if (n < 1)
+		n = 1;
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	// Don't use more threads than there are rows:
+	if (threads > faces * n)
+		threads = faces * n;
+
+	if (threads < 1)
+		threads = 1;
+
+	mesh->shape   = shape;
+	mesh->threads = threads;
+	mesh->nvert   = (size_t) faces * n * n * 6;
+
+	if ((mesh->vert = malloc(mesh->nvert * sizeof(struct vertex))) == NULL) {
+		fprintf(stderr, "Could not allocate %zu vertices\n", mesh->nvert);
+		mesh->nvert = 0;
+		return false;
+	}
+
+	struct job job[threads];
+	int rows = faces * n;
+	double start = now();
+
+	for (int i = 0; i < threads; i++) {
+		job[i] = (struct job) {
+			.mesh      = mesh,
+			.n         = n,
+			.row_begin = rows * i / threads,
+			.row_end   = rows * (i + 1) / threads,
+		};
+
+		// The calling thread does the last job itself, and any job
+		// that it could not start a thread for:
+		if (i < threads - 1)
+			job[i].started = pthread_create(&job[i].thread, NULL, run_job, &job[i]) == 0;
+	}
+
+	for (int i = 0; i < threads; i++)
+		if (!job[i].started)
+			run_job(&job[i]);
+
+	for (int i = 0; i < threads - 1; i++)
+		if (job[i].started)
+			pthread_join(job[i].thread, NULL);
+
+	mesh->seconds = now() - start;
+	return true;
+}
+
+// Print generation time and memory use. Large meshes are also normalized
+// per million triangles; for small ones, that only scales up the overhead.
+// Goes to stderr, to keep the benchmarks' JSON output on stdout clean:
+void
+mesh_report (const struct mesh *mesh)
+{
+	size_t tris  = mesh->nvert / 3;
+	double mtris = tris / 1e6;
+	double mbyte = mesh->nvert * sizeof(struct vertex) / 1048576.0;
+
+	fprintf(stderr, "Generated %s: %zu triangles in %.2f ms on %d threads, %.2f MiB",
+		mesh_shape_name(mesh->shape), tris,
+		mesh->seconds * 1e3, mesh->threads, mbyte);
+
+	if (tris >= MIN_REPORT_TRIANGLES)
+		fprintf(stderr, " (%.2f ms and %.2f MiB per million triangles)",
+			mesh->seconds * 1e3 / mtris, mbyte / mtris);
+
+	fputc('\n', stderr);
+}
+
+void
+mesh_free (struct mesh *mesh)
+{
+	free(mesh->vert);
+	mesh->vert  = NULL;
+	mesh->nvert = 0;
+}
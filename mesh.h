@@ -0,0 +1,22 @@
+#include <stdbool.h>
+#include <stddef.h>
+
+enum mesh_shape {
+	MESH_CUBE,
+	MESH_SPHERE,
+	MESH_GRID,
+};
+
+struct mesh {
+	struct vertex	*vert;
+	size_t		 nvert;
+	enum mesh_shape	 shape;
+	int		 threads;
+	double		 seconds;
+};
+
+bool mesh_shape_parse (const char *name, enum mesh_shape *shape);
+const char *mesh_shape_name (enum mesh_shape shape);
+bool mesh_generate (struct mesh *mesh, enum mesh_shape shape, size_t triangles, int threads);
+void mesh_report (const struct mesh *mesh);
+void mesh_free (struct mesh *mesh);
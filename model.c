@@ -1,57 +1,50 @@
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <math.h>
 #include <GL/gl.h>
 
 #include "matrix.h"
+#include "model.h"
 #include "program.h"
+#include "resource.h"
+#include "stats.h"
+#include "trace.h"
 #include "util.h"
-
-struct point {
-	float x;
-	float y;
-	float z;
-} __attribute__((packed));
-
-struct color {
-	float r;
-	float g;
-	float b;
-} __attribute__((packed));
-
-// Each vertex has position, normal and color:
-struct vertex {
-	struct point pos;
-	struct point normal;
-	struct color color;
-} __attribute__((packed));
-
-// Each triangle has three vertices:
-struct triangle {
-	struct vertex vert[3];
-} __attribute__((packed));
-
-// Each corner point has a position and a color:
-struct corner {
-	struct point pos;
-	struct color color;
-} __attribute__((packed));
-
-// Each face has a single normal, four corner points,
-// and two triangles:
-struct face {
-	struct corner corner[4];
-	struct point normal;
-	struct triangle tri[2];
-} __attribute__((packed));
-
-// Each cube has six faces:
-struct cube {
-	struct face face[6];
-} __attribute__((packed));
+#include "vertex.h"
 
 static GLuint vao, vbo;
 static float matrix[16] = { 0 };
 
+// Vertices built by model_build(), and the number of them uploaded:
+static struct mesh mesh;
+static size_t nvert;
+
+// Shape and size of the generated model; the default is the 12-triangle cube:
+static struct {
+	enum mesh_shape	shape;
+	size_t		triangles;
+	bool		report;
+} scene = {
+	.shape     = MESH_CUBE,
+	.triangles = 12,
+};
+
+// Number of animated objects; zero means the single, mouse-driven cube:
+static struct {
+	size_t			count;
+	enum animate_mode	mode;
+} objects;
+
+// Number of materials the objects are textured with; zero means untextured:
+static struct {
+	size_t			count;
+	enum material_mode	mode;
+} materials;
+
+// Number of point lights shining on untextured objects:
+static size_t lights;
+
 // Mouse movement:
 static struct {
 	int x;
@@ -65,135 +58,106 @@ static struct point rot = {
 	.z = 0.0f,
 };
 
-// Return the cross product of two vectors:
+// Select the shape and size of the model, and whether to print how long it
+// took to generate; call before model_build():
+void
+model_set_scene (enum mesh_shape shape, size_t triangles, bool report)
+{
+	scene.shape     = shape;
+	scene.triangles = triangles;
+	scene.report    = report;
+}
+
+// (Re)create the animation state for the selected objects:
 static void
-cross (struct point *result, const struct point *a, const struct point *b)
+model_init_objects (void)
 {
-	result->x = a->y * b->z - a->z * b->y;
-	result->y = a->z * b->x - a->x * b->z;
-	result->z = a->x * b->y - a->y * b->x;
+	animate_destroy();
+
+	// Fall back to the single cube if animation is not supported:
+	if (objects.count > 0 && !animate_init(objects.count, objects.mode))
+		objects.count = 0;
+
+	material_destroy();
+
+	// Draw untextured if materials are not supported:
+	if (objects.count > 0 && materials.count > 0)
+		if (!program_cube_mat_available() || !material_init(objects.count, materials.count, materials.mode))
+			materials.count = 0;
+
+	light_destroy();
+
+	if (objects.count > 0 && lights > 0 && !light_init(lights))
+		lights = 0;
 }
 
-// Initialize the model:
+// Light the objects with the given number of moving point lights; call
+// before model_set_objects():
 void
-model_init (void)
+model_set_lights (size_t count)
 {
-	// Define our cube:
-	struct cube cube =
-	{ .face[0].corner =
-	  { { 0, 1, 0 }
-	  , { 1, 0, 0 }
-	  , { 0, 0, 0 }
-	  , { 1, 1, 0 }
-	  }
-	, .face[1].corner =
-	  { { 0, 0, 0 }
-	  , { 1, 0, 1 }
-	  , { 0, 0, 1 }
-	  , { 1, 0, 0 }
-	  }
-	, .face[2].corner =
-	  { { 1, 0, 0 }
-	  , { 1, 1, 1 }
-	  , { 1, 0, 1 }
-	  , { 1, 1, 0 }
-	  }
-	, .face[3].corner =
-	  { { 1, 1, 0 }
-	  , { 0, 1, 1 }
-	  , { 1, 1, 1 }
-	  , { 0, 1, 0 }
-	  }
-	, .face[4].corner =
-	  { { 0, 1, 0 }
-	  , { 0, 0, 1 }
-	  , { 0, 1, 1 }
-	  , { 0, 0, 0 }
-	  }
-	, .face[5].corner =
-	  { { 0, 1, 1 }
-	  , { 1, 0, 1 }
-	  , { 1, 1, 1 }
-	  , { 0, 0, 1 }
-	  }
-	} ;
-
-	// Generate colors for each corner based on its position:
-	FOREACH (cube.face, face) {
-		FOREACH (face->corner, corner) {
-			corner->color.r = corner->pos.x * 0.8f + 0.1f;
-			corner->color.g = corner->pos.y * 0.8f + 0.1f;
-			corner->color.b = corner->pos.z * 0.8f + 0.1f;
-		}
-	}
+	lights = count;
+}
 
-	// Center cube on the origin by translating corner points:
-	FOREACH (cube.face, face) {
-		FOREACH (face->corner, corner) {
-			corner->pos.x -= 0.5f;
-			corner->pos.y -= 0.5f;
-			corner->pos.z -= 0.5f;
-		}
-	}
+// Texture the objects with the given number of materials; call before
+// model_set_objects():
+void
+model_set_materials (size_t count, enum material_mode mode)
+{
+	materials.count = count;
+	materials.mode  = mode;
+}
 
-	// Face normals are cross product of two ribs:
-	FOREACH (cube.face, face) {
-
-		// First rib is (corner 3 - corner 0):
-		struct point a = {
-			.x = face->corner[3].pos.x - face->corner[0].pos.x,
-			.y = face->corner[3].pos.y - face->corner[0].pos.y,
-			.z = face->corner[3].pos.z - face->corner[0].pos.z,
-		};
-
-		// Second rib is (corner 2 - corner 0):
-		struct point b = {
-			.x = face->corner[2].pos.x - face->corner[0].pos.x,
-			.y = face->corner[2].pos.y - face->corner[0].pos.y,
-			.z = face->corner[2].pos.z - face->corner[0].pos.z,
-		};
-
-		// Face normal is cross product of these two ribs:
-		cross(&face->normal, &a, &b);
-	}
+// Draw many objects, each animated on the CPU or the GPU:
+void
+model_set_objects (size_t count, enum animate_mode mode)
+{
+	objects.count = count;
+	objects.mode  = mode;
 
-	// Create two triangles for each face:
-	FOREACH (cube.face, face) {
+	// Once uploaded, switch over right away:
+	if (vao != 0)
+		model_init_objects();
+}
 
-		// Corners to compose triangles of, chosen in
-		// such a way that both triangles rotate CCW:
-		int index[2][3] = { { 0, 2, 1 }, { 1, 3, 0 } };
+// Build the vertex array. Touches no GL state, so it is safe to call from a
+// worker thread. On failure, the mesh is left empty:
+bool
+model_build (void)
+{
+	TRACE_FUNC();
 
-		for (int t = 0; t < 2; t++) {
-			for (int v = 0; v < 3; v++) {
-				int c = index[t][v];
-				struct corner *corner = &face->corner[c];
-				struct vertex *vertex = &face->tri[t].vert[v];
+	if (!mesh_generate(&mesh, scene.shape, scene.triangles, 0))
+		return false;
 
-				vertex->pos = corner->pos;
-				vertex->normal = face->normal;
-				vertex->color = corner->color;
-			}
-		}
-	}
+	if (scene.report)
+		mesh_report(&mesh);
 
-	// Copy vertices into separate array for drawing:
-	struct vertex vertex[6 * 2 * 3];
-	struct vertex *cur = vertex;
+	return true;
+}
 
-	FOREACH (cube.face, face) {
-		FOREACH (face->tri, tri) {
-			for (int v = 0; v < 3; v++) {
-				*cur++ = tri->vert[v];
-			}
-		}
-	}
+// Fall back to the 12-triangle cube when the selected model can't be built:
+bool
+model_build_cube (void)
+{
+	fprintf(stderr, "Could not generate %s with %zu triangles, using the cube\n",
+		mesh_shape_name(scene.shape), scene.triangles);
+
+	model_set_scene(MESH_CUBE, 12, scene.report);
+	return model_build();
+}
+
+// Upload the vertex array; needs the cube program to be linked:
+void
+model_upload (void)
+{
+	TRACE_FUNC();
 
 	// Generate empty buffer:
-	glGenBuffers(1, &vbo);
+	vbo = resource_create(RESOURCE_BUFFER, "model");
 
 	// Generate empty vertex array object:
-	glGenVertexArrays(1, &vao);
+	vao = resource_create(RESOURCE_VERTEX_ARRAY, "model");
 
 	// Set as current vertex array:
 	glBindVertexArray(vao);
@@ -223,12 +187,116 @@ model_init (void)
 	}
 
 	// Upload vertex data:
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex), vertex, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, mesh.nvert * sizeof(struct vertex), mesh.vert, GL_STATIC_DRAW);
+	resource_size(RESOURCE_BUFFER, vbo, mesh.nvert * sizeof(struct vertex));
+
+	// The buffer holds its own copy now:
+	nvert = mesh.nvert;
+	mesh_free(&mesh);
+
+	model_init_objects();
+}
+
+// Initialize the model. Fails if not even the cube can be built:
+bool
+model_init (void)
+{
+	TRACE_FUNC();
+
+	if (!model_build() && !model_build_cube())
+		return false;
+
+	model_upload();
+	return true;
+}
+
+// Delete the vertex array and the objects' state, as when the GL context
+// goes away. The scene and object settings are kept for the next upload:
+void
+model_destroy (void)
+{
+	light_destroy();
+	material_destroy();
+	animate_destroy();
+
+	resource_delete(RESOURCE_BUFFER, vbo);
+	resource_delete(RESOURCE_VERTEX_ARRAY, vao);
+
+	vbo = vao = 0;
+	nvert = 0;
+}
+
+// Draw textured objects. With a texture array, all of them are drawn in one
+// call; with separate textures, the program and texture are set up for each
+// object, as a renderer that binds each object's material would:
+static void
+model_draw_materials (void)
+{
+	if (material_mode() == MATERIAL_ARRAY) {
+		program_cube_mat_use();
+		program_cube_mat_base(0);
+		material_bind(0);
+
+		glDrawArraysInstanced(GL_TRIANGLES, 0, nvert, objects.count);
+		stats_count(STAT_DRAWS, 1);
+		return;
+	}
+
+	// Only the texture changes between objects:
+	program_cube_mat_use();
+
+	for (size_t i = 0; i < objects.count; i++) {
+		program_cube_mat_base(i);
+		material_bind(i);
+
+		glDrawArraysInstanced(GL_TRIANGLES, 0, nvert, 1);
+	}
+
+	stats_count(STAT_DRAWS, objects.count);
+}
+
+// Draw all objects in one instanced call, taking their model matrices
+// from the animation buffer:
+static void
+model_draw_objects (void)
+{
+	animate_step();
+
+	glBindVertexArray(vao);
+	stats_count(STAT_VERTEX_ARRAYS, 1);
+	animate_bind();
+
+	if (material_count() > 0) {
+		model_draw_materials();
+		return;
+	}
+
+	if (light_count() > 0) {
+		light_update();
+		program_light_use();
+		light_bind();
+
+		glDrawArraysInstanced(GL_TRIANGLES, 0, nvert, objects.count);
+		stats_count(STAT_DRAWS, 1);
+		return;
+	}
+
+	program_cube_inst_use();
+
+	glDrawArraysInstanced(GL_TRIANGLES, 0, nvert, objects.count);
+	stats_count(STAT_DRAWS, 1);
 }
 
 void
 model_draw (void)
 {
+	TRACE_FUNC();
+
+	if (objects.count > 0) {
+		model_draw_objects();
+		return;
+	}
+
 	static float angle = 0.0f;
 
 	// Rotate slightly:
@@ -240,12 +308,55 @@ model_draw (void)
 	// Use our own shaders:
 	program_cube_use();
 
-	// Don't clip against background:
-	glClear(GL_DEPTH_BUFFER_BIT);
-
 	// Draw all the triangles in the buffer:
 	glBindVertexArray(vao);
-	glDrawArrays(GL_TRIANGLES, 0, 12 * 3);
+	glDrawArrays(GL_TRIANGLES, 0, nvert);
+
+	stats_count(STAT_VERTEX_ARRAYS, 1);
+	stats_count(STAT_DRAWS, 1);
+}
+
+// Number of pickable objects:
+size_t
+model_object_count (void)
+{
+	return objects.count > 0 ? objects.count : 1;
+}
+
+// Bounding sphere of an object:
+void
+model_object_bounds (size_t index, float *center, float *radius)
+{
+	if (objects.count > 0) {
+		animate_bounds(index, center, radius);
+		return;
+	}
+
+	// The single cube sits at the origin:
+	center[0] = center[1] = center[2] = 0.0f;
+	*radius = sqrtf(3.0f) / 2;
+}
+
+// Whether objects take their matrices from the animation buffer:
+bool
+model_instanced (void)
+{
+	return objects.count > 0;
+}
+
+// Draw the geometry of all objects with the currently bound program, as
+// done for the ID buffer used for picking:
+void
+model_draw_geometry (void)
+{
+	glBindVertexArray(vao);
+
+	if (objects.count > 0) {
+		animate_bind();
+		glDrawArraysInstanced(GL_TRIANGLES, 0, nvert, objects.count);
+	}
+	else
+		glDrawArrays(GL_TRIANGLES, 0, nvert);
 }
 
 const float *
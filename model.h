@@ -1,5 +1,22 @@
-void model_init (void);
+#include "animate.h"
+#include "light.h"
+#include "material.h"
+#include "mesh.h"
+
+bool model_init (void);
+void model_set_scene (enum mesh_shape shape, size_t triangles, bool report);
+void model_set_objects (size_t count, enum animate_mode mode);
+void model_set_materials (size_t count, enum material_mode mode);
+void model_set_lights (size_t count);
+bool model_build (void);
+bool model_build_cube (void);
+void model_upload (void);
+void model_destroy (void);
 void model_draw (void);
+void model_draw_geometry (void);
+size_t model_object_count (void);
+void model_object_bounds (size_t index, float *center, float *radius);
+bool model_instanced (void);
 const float *model_matrix(void);
 void model_pan_start (int x, int y);
 void model_pan_move (int x, int y);
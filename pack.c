@@ -0,0 +1,209 @@
+#define _XOPEN_SOURCE 700
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lz.h"
+#include "pack.h"
+#include "trace.h"
+
+// Inline data declaration:
+extern const uint8_t _binary_assets_pack_start[];
+extern const uint8_t _binary_assets_pack_end[];
+
+static struct {
+	const uint8_t		 *data;
+	size_t			  size;
+	bool			  mapped;
+	struct pack_header	  header;
+	struct pack_entry	 *toc;
+	const uint8_t		**cache;
+} pack;
+
+// Asset lookups may come from worker threads:
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Check the header and table of contents of a pack in memory:
+static bool
+pack_load (const uint8_t *data, size_t size, const char *source)
+{
+	struct pack_header header;
+
+	if (size < sizeof(header))
+		goto err;
+
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.magic, PACK_MAGIC, sizeof(header.magic)) != 0 || header.version != PACK_VERSION)
+		goto err;
+
+	if ((size - sizeof(header)) / sizeof(struct pack_entry) < header.count)
+		goto err;
+
+	// The table may be unaligned, so keep a copy:
+	pack.toc   = malloc(header.count * sizeof(*pack.toc));
+	pack.cache = calloc(header.count, sizeof(*pack.cache));
+
+	if (pack.toc == NULL || pack.cache == NULL) {
+		free(pack.toc);
+		free(pack.cache);
+		return false;
+	}
+
+	memcpy(pack.toc, data + sizeof(header), header.count * sizeof(*pack.toc));
+
+	pack.data   = data;
+	pack.size   = size;
+	pack.header = header;
+	return true;
+
+err:	fprintf(stderr, "Not a valid asset pack: %s\n", source);
+	return false;
+}
+
+// Map an external pack file to load assets from, instead of the one linked
+// into the program:
+bool
+pack_open (const char *path)
+{
+	TRACE_FUNC();
+
+	struct stat st;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		perror(path);
+		return false;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size == 0) {
+		perror(path);
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping stays valid after closing the file:
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		perror(path);
+		return false;
+	}
+
+	pack_close();
+
+	if (!pack_load(data, st.st_size, path)) {
+		munmap(data, st.st_size);
+		return false;
+	}
+
+	pack.mapped = true;
+	return true;
+}
+
+static int
+compare (const void *key, const void *entry)
+{
+	return strncmp(key, ((const struct pack_entry *) entry)->name,
+		sizeof(((struct pack_entry *) 0)->name));
+}
+
+// Decompress an entry into a buffer that lives as long as the pack:
+static const uint8_t *
+unpack (const struct pack_entry *e)
+{
+	uint8_t *buf;
+
+	if ((uint64_t) e->offset + e->size > pack.size)
+		return NULL;
+
+	const uint8_t *src = pack.data + e->offset;
+
+	switch (e->codec)
+	{
+	case PACK_RAW:
+		return src;
+
+	case PACK_LZ:
+		if ((buf = malloc(e->raw_size)) == NULL)
+			return NULL;
+
+		if (!lz_decompress(src, e->size, buf, e->raw_size)) {
+			free(buf);
+			return NULL;
+		}
+
+		return buf;
+
+	default:
+		return NULL;
+	}
+}
+
+// Get an asset by its path in the source tree. Entries are decompressed on
+// first use; uncompressed entries point straight into the pack:
+const uint8_t *
+pack_get (const char *name, size_t *size)
+{
+	TRACE_FUNC();
+
+	const uint8_t *data = NULL;
+	struct pack_entry *e;
+
+	pthread_mutex_lock(&lock);
+
+	// Use the linked-in pack unless another one was opened:
+	if (pack.data == NULL)
+		pack_load(_binary_assets_pack_start,
+			_binary_assets_pack_end - _binary_assets_pack_start,
+			"linked-in");
+
+	if (pack.data != NULL && (e = bsearch(name, pack.toc, pack.header.count, sizeof(*e), compare)) != NULL) {
+		size_t i = e - pack.toc;
+
+		if (pack.cache[i] == NULL)
+			pack.cache[i] = unpack(e);
+
+		data  = pack.cache[i];
+		*size = e->raw_size;
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	if (data == NULL)
+		fprintf(stderr, "Could not load asset: %s\n", name);
+
+	return data;
+}
+
+// Free all decompressed assets and unmap the pack, if any:
+void
+pack_close (void)
+{
+	if (pack.data == NULL)
+		return;
+
+	// Uncompressed entries point into the pack itself:
+	for (uint32_t i = 0; i < pack.header.count; i++)
+		if (pack.toc[i].codec != PACK_RAW)
+			free((void *) pack.cache[i]);
+
+	free(pack.toc);
+	free(pack.cache);
+
+	if (pack.mapped)
+		munmap((void *) pack.data, pack.size);
+
+	memset(&pack, 0, sizeof(pack));
+}
@@ -0,0 +1,33 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// An asset pack starts with a header, followed by a table of contents
+// sorted by name, followed by the data of each entry. All numbers are in
+// host byte order, since packs are built along with the program:
+#define PACK_MAGIC	"GOPK"
+#define PACK_VERSION	1
+
+enum pack_codec {
+	PACK_RAW,
+	PACK_LZ,
+};
+
+struct pack_header {
+	char		magic[4];
+	uint32_t	version;
+	uint32_t	count;
+	uint32_t	reserved;
+};
+
+struct pack_entry {
+	char		name[48];
+	uint32_t	offset;		// From the start of the pack
+	uint32_t	size;		// Stored size
+	uint32_t	raw_size;	// Size after decompression
+	uint32_t	codec;
+};
+
+bool pack_open (const char *path);
+const uint8_t *pack_get (const char *name, size_t *size);
+void pack_close (void);
@@ -0,0 +1,580 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <GL/gl.h>
+
+#include "debug.h"
+#include "extension.h"
+#include "matrix.h"
+#include "model.h"
+#include "pack.h"
+#include "pick.h"
+#include "program.h"
+#include "resource.h"
+#include "trace.h"
+#include "util.h"
+#include "view.h"
+
+// Uniform grid over the object bounds, with the objects overlapping each
+// cell stored contiguously:
+static struct {
+	float	 min[3];
+	float	 cell[3];
+	int	 dim[3];
+	size_t	*start;
+	size_t	*items;
+	float	*spheres;
+	size_t	 count;
+} grid;
+
+// GPU ID buffer and the asynchronous readback of one pixel:
+static struct {
+	GLuint	 program;
+	GLuint	 fbo;
+	GLuint	 rbo[2];
+	GLuint	 pbo;
+	GLsync	 fence;
+	int	 width;
+	int	 height;
+	GLint	 loc_view;
+	GLint	 loc_model;
+	GLint	 loc_instanced;
+} gpu;
+
+// Pending request:
+static struct {
+	bool		 pending;
+	bool		 inflight;
+	int		 x;
+	int		 y;
+	unsigned	 frame;
+	struct pick	 result;
+	bool		 ready;
+} req;
+
+static enum pick_backend backend = PICK_CPU;
+static unsigned frame;
+
+static const char *backends[] = {
+	[PICK_CPU] = "cpu",
+	[PICK_GPU] = "gpu",
+};
+
+bool
+pick_backend_parse (const char *name, enum pick_backend *b)
+{
+	FOREACH (backends, n)
+		if (strcmp(*n, name) == 0) {
+			*b = n - backends;
+			return true;
+		}
+
+	return false;
+}
+
+const char *
+pick_backend_name (enum pick_backend b)
+{
+	return backends[b];
+}
+
+static int
+cell_index (const int *c)
+{
+	return (c[2] * grid.dim[1] + c[1]) * grid.dim[0] + c[0];
+}
+
+static void
+cell_of (int *c, const float *p)
+{
+	for (int i = 0; i < 3; i++) {
+		c[i] = (p[i] - grid.min[i]) / grid.cell[i];
+
+		if (c[i] < 0)
+			c[i] = 0;
+
+		if (c[i] >= grid.dim[i])
+			c[i] = grid.dim[i] - 1;
+	}
+}
+
+static void
+grid_free (void)
+{
+	free(grid.start);
+	free(grid.items);
+	free(grid.spheres);
+	memset(&grid, 0, sizeof(grid));
+}
+
+// Build the grid from the model's bounding spheres. Two passes: count the
+// objects per cell, then fill them in. Fails, leaving an empty grid, if
+// out of memory:
+static bool
+grid_build (void)
+{
+	TRACE_FUNC();
+
+	float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+	grid_free();
+
+	grid.count   = model_object_count();
+	grid.spheres = malloc(grid.count * 4 * sizeof(float));
+
+	if (grid.spheres == NULL) {
+		grid_free();
+		return false;
+	}
+
+	for (int i = 0; i < 3; i++)
+		grid.min[i] = INFINITY;
+
+	for (size_t o = 0; o < grid.count; o++) {
+		float *s = &grid.spheres[o * 4];
+
+		model_object_bounds(o, s, &s[3]);
+
+		for (int i = 0; i < 3; i++) {
+			grid.min[i] = fminf(grid.min[i], s[i] - s[3]);
+			max[i]      = fmaxf(max[i],      s[i] + s[3]);
+		}
+	}
+
+	// About one object per cell:
+	int side = ceil(cbrt(grid.count));
+
+	if (side > 128)
+		side = 128;
+
+	size_t ncells = 1;
+
+	for (int i = 0; i < 3; i++) {
+		grid.dim[i]  = side;
+		grid.cell[i] = (max[i] - grid.min[i]) / side;
+		ncells *= side;
+	}
+
+	if ((grid.start = calloc(ncells + 1, sizeof(size_t))) == NULL) {
+		grid_free();
+		return false;
+	}
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t o = 0; o < grid.count; o++) {
+			const float *s = &grid.spheres[o * 4];
+			float lo[3], hi[3];
+			int a[3], b[3], c[3];
+
+			for (int i = 0; i < 3; i++) {
+				lo[i] = s[i] - s[3];
+				hi[i] = s[i] + s[3];
+			}
+
+			cell_of(a, lo);
+			cell_of(b, hi);
+
+			for (c[2] = a[2]; c[2] <= b[2]; c[2]++)
+				for (c[1] = a[1]; c[1] <= b[1]; c[1]++)
+					for (c[0] = a[0]; c[0] <= b[0]; c[0]++)
+						if (pass == 0)
+							grid.start[cell_index(c) + 1]++;
+						else
+							grid.items[grid.start[cell_index(c)]++] = o;
+		}
+
+		if (pass == 0) {
+			// Turn the counts into offsets:
+			for (size_t i = 0; i < ncells; i++)
+				grid.start[i + 1] += grid.start[i];
+
+			grid.items = malloc(grid.start[ncells] * sizeof(size_t));
+
+			if (grid.items == NULL) {
+				grid_free();
+				return false;
+			}
+		}
+		else {
+			// Filling advanced each offset to the next cell's:
+			memmove(grid.start + 1, grid.start, ncells * sizeof(size_t));
+			grid.start[0] = 0;
+		}
+	}
+
+	return true;
+}
+
+// Rebuild the grid when the objects have changed, or a build failed:
+static bool
+grid_update (void)
+{
+	return (grid.start != NULL && grid.count == model_object_count()) || grid_build();
+}
+
+// Distance along a ray to a sphere, or INFINITY if missed:
+static float
+hit_sphere (const float *origin, const float *dir, const float *s)
+{
+	float oc[3] = { origin[0] - s[0], origin[1] - s[1], origin[2] - s[2] };
+	float b = oc[0] * dir[0] + oc[1] * dir[1] + oc[2] * dir[2];
+	float c = oc[0] * oc[0] + oc[1] * oc[1] + oc[2] * oc[2] - s[3] * s[3];
+	float d = b * b - c;
+
+	if (d < 0)
+		return INFINITY;
+
+	float t = -b - sqrtf(d);
+	return t >= 0 ? t : (-b + sqrtf(d) >= 0 ? 0 : INFINITY);
+}
+
+// Walk the grid cells along the ray in order (Amanatides and Woo), and stop
+// at the first cell that contains a hit closer than its far side:
+static int
+grid_cast (const float *origin, const float *dir)
+{
+	float tmin = 0, tmax = INFINITY;
+
+	// Clip the ray against the grid bounds:
+	for (int i = 0; i < 3; i++) {
+		float lo = grid.min[i];
+		float hi = grid.min[i] + grid.cell[i] * grid.dim[i];
+
+		if (dir[i] == 0) {
+			if (origin[i] < lo || origin[i] > hi)
+				return -1;
+			continue;
+		}
+
+		float t0 = (lo - origin[i]) / dir[i];
+		float t1 = (hi - origin[i]) / dir[i];
+
+		tmin = fmaxf(tmin, fminf(t0, t1));
+		tmax = fminf(tmax, fmaxf(t0, t1));
+	}
+
+	if (tmin > tmax)
+		return -1;
+
+	int c[3], step[3];
+	float next[3], delta[3], p[3];
+
+	for (int i = 0; i < 3; i++)
+		p[i] = origin[i] + dir[i] * tmin;
+
+	cell_of(c, p);
+
+	for (int i = 0; i < 3; i++) {
+		step[i] = dir[i] >= 0 ? 1 : -1;
+		delta[i] = dir[i] != 0 ? fabsf(grid.cell[i] / dir[i]) : INFINITY;
+
+		float edge = grid.min[i] + (c[i] + (step[i] > 0)) * grid.cell[i];
+		next[i] = dir[i] != 0 ? (edge - origin[i]) / dir[i] : INFINITY;
+	}
+
+	int best = -1;
+	float best_t = INFINITY;
+
+	for (;;) {
+		size_t cell = cell_index(c);
+
+		for (size_t i = grid.start[cell]; i < grid.start[cell + 1]; i++) {
+			size_t o = grid.items[i];
+			float t = hit_sphere(origin, dir, &grid.spheres[o * 4]);
+
+			if (t < best_t) {
+				best_t = t;
+				best = o;
+			}
+		}
+
+		// Step to the neighbouring cell with the closest boundary:
+		int axis = next[0] < next[1]
+			? (next[0] < next[2] ? 0 : 2)
+			: (next[1] < next[2] ? 1 : 2);
+
+		// Nothing further away can be closer than this hit:
+		if (best_t <= next[axis] || next[axis] > tmax)
+			break;
+
+		c[axis] += step[axis];
+		if (c[axis] < 0 || c[axis] >= grid.dim[axis])
+			break;
+
+		next[axis] += delta[axis];
+	}
+
+	return best;
+}
+
+// Cast a ray through the given window coordinates, with y pointing up:
+static int
+pick_cpu (int x, int y)
+{
+	TRACE_FUNC();
+
+	float inv[16], near[3], far[3], dir[3];
+	float width, height;
+
+	view_window_size(&width, &height);
+
+	if (!mat_invert(inv, view_matrix()))
+		return -1;
+
+	// Unproject the cursor at the near and far planes:
+	float ndc[2][3] = {
+		{ 2 * (x + 0.5f) / width - 1, 2 * (y + 0.5f) / height - 1, -1 },
+		{ 2 * (x + 0.5f) / width - 1, 2 * (y + 0.5f) / height - 1,  1 },
+	};
+
+	mat_transform(near, inv, ndc[0]);
+	mat_transform(far,  inv, ndc[1]);
+
+	for (int i = 0; i < 3; i++)
+		dir[i] = far[i] - near[i];
+
+	float len = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+	for (int i = 0; i < 3; i++)
+		dir[i] /= len;
+
+	if (!grid_update())
+		return -1;
+
+	return grid_cast(near, dir);
+}
+
+static bool
+gpu_init (void)
+{
+	// Needs the matrix storage buffer:
+	if (!extension_version(430))
+		return false;
+
+	size_t vlen, flen;
+	const uint8_t *vert = pack_get("shaders/pick/vertex.glsl", &vlen);
+	const uint8_t *frag = pack_get("shaders/pick/fragment.glsl", &flen);
+
+	if (vert == NULL || frag == NULL)
+		return false;
+
+	gpu.program = program_create("pick", vert, vert + vlen, frag, frag + flen);
+
+	gpu.loc_view      = glGetUniformLocation(gpu.program, "view_matrix");
+	gpu.loc_model     = glGetUniformLocation(gpu.program, "model_matrix");
+	gpu.loc_instanced = glGetUniformLocation(gpu.program, "instanced");
+
+	gpu.fbo = resource_create(RESOURCE_FRAMEBUFFER, "pick");
+
+	FOREACH (gpu.rbo, r)
+		*r = resource_create(RESOURCE_RENDERBUFFER, "pick");
+
+	gpu.pbo = resource_create(RESOURCE_BUFFER, "pick");
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, gpu.pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+	resource_size(RESOURCE_BUFFER, gpu.pbo, sizeof(GLuint));
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	return true;
+}
+
+// Size the ID buffer to the window:
+static void
+gpu_resize (int width, int height)
+{
+	if (gpu.width == width && gpu.height == height)
+		return;
+
+	gpu.width  = width;
+	gpu.height = height;
+
+	glBindRenderbuffer(GL_RENDERBUFFER, gpu.rbo[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, gpu.rbo[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+	// Both formats take four bytes per pixel:
+	FOREACH (gpu.rbo, r)
+		resource_size(RESOURCE_RENDERBUFFER, *r, (size_t) width * height * 4);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gpu.fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gpu.rbo[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_RENDERBUFFER, gpu.rbo[1]);
+}
+
+// Render object IDs into the single pixel under the cursor, and queue
+// an asynchronous read of it into the pixel buffer:
+static void
+gpu_submit (int x, int y)
+{
+	TRACE_FUNC();
+
+	GLint fbo;
+	float width, height;
+	const GLuint zero = 0;
+
+	// Leave the caller's depth and cull state as it was:
+	GLboolean depth_test = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean cull_face  = glIsEnabled(GL_CULL_FACE);
+
+	view_window_size(&width, &height);
+
+	// GtkGLArea renders into its own framebuffer; restore it after:
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+	gpu_resize(width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, gpu.fbo);
+
+	// Only the pixel under the cursor is of interest:
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(x, y, 1, 1);
+	glClearBufferuiv(GL_COLOR, 0, &zero);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	glUseProgram(gpu.program);
+	glUniformMatrix4fv(gpu.loc_view,  1, GL_FALSE, view_matrix());
+	glUniformMatrix4fv(gpu.loc_model, 1, GL_FALSE, model_matrix());
+	glUniform1i(gpu.loc_instanced, model_instanced());
+
+	model_draw_geometry();
+
+	if (!cull_face)
+		glDisable(GL_CULL_FACE);
+
+	if (!depth_test)
+		glDisable(GL_DEPTH_TEST);
+
+	glDisable(GL_SCISSOR_TEST);
+
+	// Copy into the pixel buffer without waiting for the result:
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, gpu.pbo);
+	glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	gpu.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+}
+
+// Check without blocking whether the readback is done:
+static bool
+gpu_poll (int *object)
+{
+	GLenum status = glClientWaitSync(gpu.fence, 0, 0);
+
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return false;
+
+	glDeleteSync(gpu.fence);
+	gpu.fence = NULL;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, gpu.pbo);
+	GLuint *id = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
+	*object = (int) *id - 1;
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	return true;
+}
+
+// Select the backend; falls back to the CPU if the GPU path is unsupported:
+void
+pick_init (enum pick_backend b)
+{
+	backend = b;
+
+	if (backend == PICK_GPU && gpu.program == 0 && !gpu_init()) {
+		fputs("GPU picking needs OpenGL 4.3, using the CPU\n", stderr);
+		backend = PICK_CPU;
+	}
+}
+
+// Delete the GPU objects and the grid, as when the GL context goes away.
+// A request in flight is dropped:
+void
+pick_destroy (void)
+{
+	grid_free();
+
+	if (gpu.fence != NULL)
+		glDeleteSync(gpu.fence);
+
+	resource_delete(RESOURCE_PROGRAM, gpu.program);
+	resource_delete(RESOURCE_FRAMEBUFFER, gpu.fbo);
+	resource_delete(RESOURCE_BUFFER, gpu.pbo);
+
+	FOREACH (gpu.rbo, r)
+		resource_delete(RESOURCE_RENDERBUFFER, *r);
+
+	memset(&gpu, 0, sizeof(gpu));
+	req.inflight = false;
+}
+
+// Request the object under the given window coordinates, with y pointing
+// up. A newer request replaces one that has not been submitted yet:
+void
+pick_request (int x, int y)
+{
+	req.pending = true;
+	req.x       = x;
+	req.y       = y;
+	req.frame   = frame;
+}
+
+// Call once per frame, after drawing, with the GL context current. Returns
+// true when a result is available:
+bool
+pick_frame (struct pick *result)
+{
+	TRACE_FUNC();
+	DEBUG_SCOPE("pick");
+
+	unsigned now = frame++;
+	int object;
+
+	if (req.inflight && gpu_poll(&object)) {
+		req.inflight = false;
+		req.ready    = true;
+		req.result.object = object;
+	}
+
+	if (req.pending && !req.inflight) {
+		req.pending = false;
+
+		// Without memory for the grid, pick on the GPU instead:
+		if (backend == PICK_CPU && !grid_update() && (gpu.program != 0 || gpu_init())) {
+			fputs("Could not build the picking grid, using the GPU\n", stderr);
+			backend = PICK_GPU;
+		}
+
+		req.result  = (struct pick) {
+			.x       = req.x,
+			.y       = req.y,
+			.backend = backend,
+			.frame   = req.frame,
+		};
+
+		if (backend == PICK_CPU) {
+			req.result.object = pick_cpu(req.x, req.y);
+			req.ready = true;
+		}
+		else {
+			gpu_submit(req.x, req.y);
+			req.inflight = true;
+		}
+	}
+
+	if (!req.ready)
+		return false;
+
+	req.ready = false;
+	*result = req.result;
+	result->latency = now - result->frame;
+	return true;
+}
@@ -0,0 +1,22 @@
+#include <stdbool.h>
+
+enum pick_backend {
+	PICK_CPU,
+	PICK_GPU,
+};
+
+struct pick {
+	int			x;
+	int			y;
+	int			object;		// -1 if none
+	enum pick_backend	backend;
+	unsigned		frame;		// Frame of the request
+	unsigned		latency;	// Frames until the result
+};
+
+bool pick_backend_parse (const char *name, enum pick_backend *backend);
+const char *pick_backend_name (enum pick_backend backend);
+void pick_init (enum pick_backend backend);
+void pick_destroy (void);
+void pick_request (int x, int y);
+bool pick_frame (struct pick *result);
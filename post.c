@@ -0,0 +1,102 @@
+#include <GL/gl.h>
+
+#include "graph.h"
+#include "post.h"
+#include "program.h"
+#include "resource.h"
+#include "stats.h"
+
+// The passes draw one triangle made from the vertex index alone, but still
+// need a vertex array to be bound:
+static GLuint vao;
+
+static void
+draw (float dx, float dy, float weight)
+{
+	if (vao == 0)
+		vao = resource_create(RESOURCE_VERTEX_ARRAY, "post");
+
+	program_post_use(dx, dy, weight);
+	glBindVertexArray(vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	stats_count(STAT_VERTEX_ARRAYS, 1);
+	stats_count(STAT_DRAWS, 1);
+}
+
+static void
+downsample (void)
+{
+	draw(0.0f, 0.0f, 0.0f);
+}
+
+static void
+blur_x (void)
+{
+	draw(1.0f, 0.0f, 0.0f);
+}
+
+static void
+blur_y (void)
+{
+	draw(0.0f, 1.0f, 0.0f);
+}
+
+static void
+composite (void)
+{
+	draw(0.0f, 0.0f, 0.5f);
+}
+
+// Add a bloom to the render graph: copy the source to half size, blur it
+// the given number of times in both directions, and add the result onto
+// the source in the target. Each step writes a new attachment, and the
+// graph lets steps that do not overlap share memory:
+void
+post_add (int source, int target, int blurs)
+{
+	int prev = graph_attachment("bloom", GRAPH_RGBA8, 0.5f);
+
+	graph_add(&(struct graph_pass) {
+		.name  = "downsample",
+		.run   = downsample,
+		.read  = { source },
+		.write = { prev },
+	});
+
+	for (int i = 0; i < blurs; i++) {
+		int x = graph_attachment("bloom x", GRAPH_RGBA8, 0.5f);
+		int y = graph_attachment("bloom y", GRAPH_RGBA8, 0.5f);
+
+		graph_add(&(struct graph_pass) {
+			.name  = "blur x",
+			.run   = blur_x,
+			.read  = { prev },
+			.write = { x },
+		});
+
+		graph_add(&(struct graph_pass) {
+			.name  = "blur y",
+			.run   = blur_y,
+			.read  = { x },
+			.write = { y },
+		});
+
+		prev = y;
+	}
+
+	graph_add(&(struct graph_pass) {
+		.name  = "composite",
+		.run   = composite,
+		.read  = { source, prev },
+		.write = { target },
+	});
+}
+
+// Delete the vertex array, as when the GL context goes away:
+void
+post_destroy (void)
+{
+	resource_delete(RESOURCE_VERTEX_ARRAY, vao);
+	vao = 0;
+}
@@ -0,0 +1,2 @@
+void post_add (int source, int target, int blurs);
+void post_destroy (void);
@@ -0,0 +1,219 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "present.h"
+#include "util.h"
+
+static struct {
+	EGLDisplay	display;
+	EGLSurface	surface;
+	EGLContext	context;
+	bool		own;	// Whether the display is ours to terminate
+} egl = {
+	.display = EGL_NO_DISPLAY,
+	.surface = EGL_NO_SURFACE,
+	.context = EGL_NO_CONTEXT,
+};
+
+static const char *backends[] = {
+	[PRESENT_AREA] = "area",
+	[PRESENT_EGL]  = "egl",
+};
+
+bool
+present_backend_parse (const char *name, enum present_backend *b)
+{
+	FOREACH (backends, n)
+		if (strcmp(*n, name) == 0) {
+			*b = n - backends;
+			return true;
+		}
+
+	return false;
+}
+
+const char *
+present_backend_name (enum present_backend b)
+{
+	return backends[b];
+}
+
+// Get the EGL display for an X11 display, or a surfaceless one if none:
+static EGLDisplay
+get_display (void *display)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)
+		eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	if (get_platform_display != NULL) {
+		EGLDisplay d = display != NULL
+			? get_platform_display(EGL_PLATFORM_X11_KHR, display, NULL)
+			: get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+
+		if (d != EGL_NO_DISPLAY)
+			return d;
+	}
+
+	return eglGetDisplay(display != NULL ? (EGLNativeDisplayType) display : EGL_DEFAULT_DISPLAY);
+}
+
+// Create the newest core context the driver offers:
+static EGLContext
+create_context (EGLConfig config)
+{
+	static const EGLint versions[][2] = {
+		{ 4, 5 },
+		{ 3, 3 },
+	};
+
+	FOREACH (versions, v) {
+		EGLint attribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION,		(*v)[0],
+			EGL_CONTEXT_MINOR_VERSION,		(*v)[1],
+			EGL_CONTEXT_OPENGL_PROFILE_MASK,	EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifdef DEBUG
+			EGL_CONTEXT_OPENGL_DEBUG,		EGL_TRUE,
+#endif
+			EGL_NONE,
+		};
+
+		EGLContext context = eglCreateContext(egl.display, config, EGL_NO_CONTEXT, attribs);
+
+		if (context != EGL_NO_CONTEXT)
+			return context;
+	}
+
+	return EGL_NO_CONTEXT;
+}
+
+// Render straight into an X11 window through an EGL window surface, which
+// is swapped without going through the toolkit's compositing. Without a
+// window, render into a pbuffer of the given size instead, so that the
+// path can be timed without a window system. Makes the context current:
+bool
+present_init (void *display, unsigned long window, int width, int height, int interval)
+{
+	EGLint major, minor, nconfigs;
+	EGLConfig config;
+
+	EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE,	window ? EGL_WINDOW_BIT : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE,	EGL_OPENGL_BIT,
+		EGL_RED_SIZE,		8,
+		EGL_GREEN_SIZE,		8,
+		EGL_BLUE_SIZE,		8,
+		EGL_DEPTH_SIZE,		24,
+		EGL_NONE,
+	};
+
+	EGLint pbuffer_attribs[] = {
+		EGL_WIDTH,	width,
+		EGL_HEIGHT,	height,
+		EGL_NONE,
+	};
+
+	// The EGL display of an X11 display is shared with anyone else using
+	// it in this process, such as the toolkit; only a surfaceless one is
+	// ours alone:
+	egl.own = display == NULL;
+
+	if ((egl.display = get_display(display)) == EGL_NO_DISPLAY) {
+		fputs("Could not get EGL display\n", stderr);
+		return false;
+	}
+
+	if (!eglInitialize(egl.display, &major, &minor)) {
+		fputs("Could not initialize EGL\n", stderr);
+		egl.display = EGL_NO_DISPLAY;
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		fputs("Could not bind OpenGL API\n", stderr);
+		present_destroy();
+		return false;
+	}
+
+	if (!eglChooseConfig(egl.display, config_attribs, &config, 1, &nconfigs) || nconfigs == 0) {
+		fputs("No EGL config for the surface\n", stderr);
+		present_destroy();
+		return false;
+	}
+
+	egl.surface = window
+		? eglCreateWindowSurface(egl.display, config, (EGLNativeWindowType) window, NULL)
+		: eglCreatePbufferSurface(egl.display, config, pbuffer_attribs);
+
+	if (egl.surface == EGL_NO_SURFACE) {
+		fputs("Could not create EGL surface\n", stderr);
+		present_destroy();
+		return false;
+	}
+
+	if ((egl.context = create_context(config)) == EGL_NO_CONTEXT) {
+		fputs("Could not create OpenGL context\n", stderr);
+		present_destroy();
+		return false;
+	}
+
+	if (!present_make_current()) {
+		fputs("Could not make context current\n", stderr);
+		present_destroy();
+		return false;
+	}
+
+	present_set_interval(interval);
+	return true;
+}
+
+bool
+present_make_current (void)
+{
+	return eglMakeCurrent(egl.display, egl.surface, egl.surface, egl.context);
+}
+
+// Set the number of vertical blanks to wait for on each swap; zero swaps
+// right away:
+bool
+present_set_interval (int interval)
+{
+	if (eglSwapInterval(egl.display, interval))
+		return true;
+
+	fprintf(stderr, "Could not set swap interval %d\n", interval);
+	return false;
+}
+
+void
+present_swap (void)
+{
+	eglSwapBuffers(egl.display, egl.surface);
+}
+
+// Destroy the context and surface; the window and its display are left
+// alone:
+void
+present_destroy (void)
+{
+	if (egl.display == EGL_NO_DISPLAY)
+		return;
+
+	eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	if (egl.context != EGL_NO_CONTEXT)
+		eglDestroyContext(egl.display, egl.context);
+
+	if (egl.surface != EGL_NO_SURFACE)
+		eglDestroySurface(egl.display, egl.surface);
+
+	if (egl.own)
+		eglTerminate(egl.display);
+
+	egl.display = EGL_NO_DISPLAY;
+	egl.surface = EGL_NO_SURFACE;
+	egl.context = EGL_NO_CONTEXT;
+}
@@ -0,0 +1,14 @@
+#include <stdbool.h>
+
+enum present_backend {
+	PRESENT_AREA,
+	PRESENT_EGL,
+};
+
+bool present_backend_parse (const char *name, enum present_backend *backend);
+const char *present_backend_name (enum present_backend backend);
+bool present_init (void *display, unsigned long window, int width, int height, int interval);
+bool present_make_current (void);
+bool present_set_interval (int interval);
+void present_swap (void);
+void present_destroy (void);
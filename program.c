@@ -1,31 +1,28 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <GL/gl.h>
 
+#include "extension.h"
 #include "model.h"
+#include "pack.h"
+#include "trace.h"
 #include "view.h"
 #include "program.h"
+#include "resource.h"
+#include "stats.h"
 #include "util.h"
 
-// Define inline data:
-#define DATA_DEF(x)							\
-	extern const uint8_t _binary_shaders_## x ##_glsl_start[];	\
-	extern const uint8_t _binary_shaders_## x ##_glsl_end[];
+// Shader in the asset pack:
+#define SHADER(x)	{ .name = "shaders/" x ".glsl" }
 
-#define SHADER(x)					\
-	{ .buf = _binary_shaders_ ## x ## _glsl_start	\
-	, .end = _binary_shaders_ ## x ## _glsl_end	\
-	}
-
-// Inline data definitions:
-DATA_DEF (bkgd_vertex)
-DATA_DEF (bkgd_fragment)
-DATA_DEF (cube_vertex)
-DATA_DEF (cube_fragment)
+// Built-in program, registered with its line in the table below:
+#define PROGRAM(x)	.name = x, .file = __FILE__, .line = __LINE__
 
-// Shader structure:
+// Shader structure; the source comes from the asset pack if named:
 struct shader {
+	const char	*name;
 	const uint8_t	*buf;
 	const uint8_t	*end;
 	GLuint		 id;
@@ -56,37 +53,127 @@ static struct loc loc_cube[] = {
 	[LOC_CUBE_NORMAL] = { "normal",		ATTRIBUTE },
 };
 
+static struct loc loc_inst[] = {
+	[LOC_INST_VIEW] = { "view_matrix",	UNIFORM   },
+};
+
+static struct loc loc_mat[] = {
+	[LOC_MAT_VIEW]      = { "view_matrix",	UNIFORM   },
+	[LOC_MAT_BASE]      = { "base_instance",	UNIFORM   },
+	[LOC_MAT_MATERIALS] = { "materials",	UNIFORM   },
+};
+
+static struct loc loc_light[] = {
+	[LOC_LIGHT_VIEW]         = { "view_matrix",	UNIFORM   },
+	[LOC_LIGHT_CLUSTER_DIMS] = { "cluster_dims",	UNIFORM   },
+	[LOC_LIGHT_VIEWPORT]     = { "viewport",	UNIFORM   },
+	[LOC_LIGHT_NEAR]         = { "near",		UNIFORM   },
+	[LOC_LIGHT_FAR]          = { "far",		UNIFORM   },
+	[LOC_LIGHT_EYE_Z]        = { "eye_z",		UNIFORM   },
+	[LOC_LIGHT_CLUSTERED]    = { "clustered",	UNIFORM   },
+	[LOC_LIGHT_COUNT]        = { "light_count",	UNIFORM   },
+};
+
+static struct loc loc_static[] = {
+	[LOC_STATIC_VIEW]      = { "view_matrix",	UNIFORM   },
+	[LOC_STATIC_LAYER]     = { "layer",		UNIFORM   },
+	[LOC_STATIC_MATERIALS] = { "materials",		UNIFORM   },
+	[LOC_STATIC_VERTEX]    = { "vertex",		ATTRIBUTE },
+	[LOC_STATIC_VCOLOR]    = { "vcolor",		ATTRIBUTE },
+	[LOC_STATIC_NORMAL]    = { "normal",		ATTRIBUTE },
+};
+
+static struct loc loc_post[] = {
+	[LOC_POST_SOURCE]    = { "source",	UNIFORM   },
+	[LOC_POST_OVERLAY]   = { "overlay",	UNIFORM   },
+	[LOC_POST_DIRECTION] = { "direction",	UNIFORM   },
+	[LOC_POST_WEIGHT]    = { "weight",	UNIFORM   },
+};
+
 // Programs:
 enum {
 	BKGD,
 	CUBE,
+	CUBE_INST,
+	CUBE_MAT,
+	STATIC,
+	LIGHT,
+	POST,
 };
 
 // Program structure:
 static struct program {
+	const char *name;
+	const char *file;
+	int line;
 	struct {
 		struct shader vert;
 		struct shader frag;
 	} shader;
 	struct loc *loc;
 	size_t nloc;
+	int version;
 	GLuint id;
 }
 programs[] = {
 	[BKGD] = {
-		.shader.vert = SHADER (bkgd_vertex),
-		.shader.frag = SHADER (bkgd_fragment),
+		PROGRAM ("background"),
+		.shader.vert = SHADER ("bkgd/vertex"),
+		.shader.frag = SHADER ("bkgd/fragment"),
 		.loc         = loc_bkgd,
 		.nloc        = NELEM(loc_bkgd),
 	},
 	[CUBE] = {
-		.shader.vert = SHADER (cube_vertex),
-		.shader.frag = SHADER (cube_fragment),
+		PROGRAM ("cube"),
+		.shader.vert = SHADER ("cube/vertex"),
+		.shader.frag = SHADER ("cube/fragment"),
 		.loc         = loc_cube,
 		.nloc        = NELEM(loc_cube),
 	},
+	[CUBE_INST] = {
+		PROGRAM ("cube instanced"),
+		.shader.vert = SHADER ("cube/instanced"),
+		.shader.frag = SHADER ("cube/fragment"),
+		.loc         = loc_inst,
+		.nloc        = NELEM(loc_inst),
+		.version     = 430,
+	},
+	[CUBE_MAT] = {
+		PROGRAM ("cube material"),
+		.shader.vert = SHADER ("cube/material"),
+		.shader.frag = SHADER ("cube/textured"),
+		.loc         = loc_mat,
+		.nloc        = NELEM(loc_mat),
+		.version     = 430,
+	},
+	[STATIC] = {
+		PROGRAM ("static"),
+		.shader.vert = SHADER ("static/vertex"),
+		.shader.frag = SHADER ("cube/textured"),
+		.loc         = loc_static,
+		.nloc        = NELEM(loc_static),
+		.version     = 430,
+	},
+	[LIGHT] = {
+		PROGRAM ("light"),
+		.shader.vert = SHADER ("light/vertex"),
+		.shader.frag = SHADER ("light/fragment"),
+		.loc         = loc_light,
+		.nloc        = NELEM(loc_light),
+		.version     = 430,
+	},
+	[POST] = {
+		PROGRAM ("post"),
+		.shader.vert = SHADER ("post/vertex"),
+		.shader.frag = SHADER ("post/fragment"),
+		.loc         = loc_post,
+		.nloc        = NELEM(loc_post),
+	},
 };
 
+// Whether the driver compiles shaders in parallel:
+static bool parallel = false;
+
 static void
 check_compile (GLuint shader)
 {
@@ -122,38 +209,99 @@ check_link (GLuint program)
 static void
 create_shader (struct shader *shader, GLenum type)
 {
+	// Fetch the source on first use:
+	if (shader->name != NULL && shader->buf == NULL) {
+		size_t size;
+
+		if ((shader->buf = pack_get(shader->name, &size)) != NULL)
+			shader->end = shader->buf + size;
+	}
+
 	const GLchar *buf = (const GLchar *) shader->buf;
 	GLint len = shader->end - shader->buf;
 
 	shader->id = glCreateShader(type);
 	glShaderSource(shader->id, 1, &buf, &len);
 	glCompileShader(shader->id);
-
-	check_compile(shader->id);
 }
 
-static void
-program_init (struct program *p)
+// Issue compile and link commands without querying their status, so that
+// drivers supporting parallel shader compilation can return immediately.
+// The program is registered with the given owner and creation site:
+static GLuint
+start_program (struct shader *vert, struct shader *frag, const char *owner, const char *file, int line)
 {
-	struct shader *vert = &p->shader.vert;
-	struct shader *frag = &p->shader.frag;
-
 	create_shader(vert, GL_VERTEX_SHADER);
 	create_shader(frag, GL_FRAGMENT_SHADER);
 
-	p->id = glCreateProgram();
+	GLuint id = resource_create_at(RESOURCE_PROGRAM, owner, file, line);
 
-	glAttachShader(p->id, vert->id);
-	glAttachShader(p->id, frag->id);
+	glAttachShader(id, vert->id);
+	glAttachShader(id, frag->id);
 
-	glLinkProgram(p->id);
-	check_link(p->id);
+	glLinkProgram(id);
+	return id;
+}
 
-	glDetachShader(p->id, vert->id);
-	glDetachShader(p->id, frag->id);
+// Wait for the program to be linked, report errors and clean up:
+static void
+finish_program (GLuint id, struct shader *vert, struct shader *frag)
+{
+	check_compile(vert->id);
+	check_compile(frag->id);
+	check_link(id);
+
+	glDetachShader(id, vert->id);
+	glDetachShader(id, frag->id);
 
 	glDeleteShader(vert->id);
 	glDeleteShader(frag->id);
+}
+
+// Compile and link a program from inline shader data:
+GLuint
+program_create_at (const char *owner, const char *file, int line,
+	const uint8_t *vert, const uint8_t *vert_end, const uint8_t *frag, const uint8_t *frag_end)
+{
+	struct shader v = { .buf = vert, .end = vert_end };
+	struct shader f = { .buf = frag, .end = frag_end };
+
+	GLuint id = start_program(&v, &f, owner, file, line);
+	finish_program(id, &v, &f);
+
+	return id;
+}
+
+// Compile and link a compute program from inline shader data:
+GLuint
+program_compute_create_at (const char *owner, const char *file, int line,
+	const uint8_t *buf, const uint8_t *end)
+{
+	struct shader c = { .buf = buf, .end = end };
+
+	create_shader(&c, GL_COMPUTE_SHADER);
+	check_compile(c.id);
+
+	GLuint id = resource_create_at(RESOURCE_PROGRAM, owner, file, line);
+
+	glAttachShader(id, c.id);
+	glLinkProgram(id);
+	check_link(id);
+
+	glDetachShader(id, c.id);
+	glDeleteShader(c.id);
+
+	return id;
+}
+
+static void
+program_init (struct program *p)
+{
+	// Skip programs the context does not support:
+	if (p->id == 0)
+		return;
+
+	finish_program(p->id, &p->shader.vert, &p->shader.frag);
 
 	FOREACH_NELEM (p->loc, p->nloc, l) {
 		switch (l->type)
@@ -169,13 +317,72 @@ program_init (struct program *p)
 	}
 }
 
+// Start compiling all programs. Let the driver use as many threads as it
+// likes if it supports KHR_parallel_shader_compile:
 void
-programs_init (void)
+programs_compile (void)
 {
+	TRACE_FUNC();
+
+	if ((parallel = extension_supported("GL_KHR_parallel_shader_compile")))
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	FOREACH (programs, p)
+		if (extension_version(p->version))
+			p->id = start_program(&p->shader.vert, &p->shader.frag,
+				p->name, p->file, p->line);
+}
+
+// Check without blocking whether all programs are linked:
+bool
+programs_ready (void)
+{
+	if (!parallel)
+		return true;
+
+	FOREACH (programs, p) {
+		GLint done;
+
+		if (p->id == 0)
+			continue;
+
+		glGetProgramiv(p->id, GL_COMPLETION_STATUS_KHR, &done);
+		if (done == GL_FALSE)
+			return false;
+	}
+
+	return true;
+}
+
+// Finish all programs, blocking until they are linked:
+void
+programs_finish (void)
+{
+	TRACE_FUNC();
+
 	FOREACH (programs, p)
 		program_init(p);
 }
 
+void
+programs_init (void)
+{
+	TRACE_FUNC();
+
+	programs_compile();
+	programs_finish();
+}
+
+// Delete all programs, so that they can be compiled again:
+void
+programs_destroy (void)
+{
+	FOREACH (programs, p) {
+		resource_delete(RESOURCE_PROGRAM, p->id);
+		p->id = 0;
+	}
+}
+
 void
 program_cube_use (void)
 {
@@ -183,6 +390,117 @@ program_cube_use (void)
 
 	glUniformMatrix4fv(loc_cube[LOC_CUBE_VIEW ].id, 1, GL_FALSE, view_matrix());
 	glUniformMatrix4fv(loc_cube[LOC_CUBE_MODEL].id, 1, GL_FALSE, model_matrix());
+
+	stats_count(STAT_PROGRAMS, 1);
+	stats_count(STAT_UNIFORMS, 2);
+}
+
+// Whether the instanced cube program is supported:
+bool
+program_cube_inst_available (void)
+{
+	return programs[CUBE_INST].id != 0;
+}
+
+void
+program_cube_inst_use (void)
+{
+	glUseProgram(programs[CUBE_INST].id);
+
+	glUniformMatrix4fv(loc_inst[LOC_INST_VIEW].id, 1, GL_FALSE, view_matrix());
+
+	stats_count(STAT_PROGRAMS, 1);
+	stats_count(STAT_UNIFORMS, 1);
+}
+
+// Whether the textured, instanced cube program is supported:
+bool
+program_cube_mat_available (void)
+{
+	return programs[CUBE_MAT].id != 0;
+}
+
+void
+program_cube_mat_use (void)
+{
+	glUseProgram(programs[CUBE_MAT].id);
+
+	glUniformMatrix4fv(loc_mat[LOC_MAT_VIEW].id, 1, GL_FALSE, view_matrix());
+	glUniform1i(loc_mat[LOC_MAT_MATERIALS].id, 0);
+
+	stats_count(STAT_PROGRAMS, 1);
+	stats_count(STAT_UNIFORMS, 2);
+}
+
+// Set the index of the first object drawn by the textured cube program:
+void
+program_cube_mat_base (GLint base)
+{
+	glUniform1i(loc_mat[LOC_MAT_BASE].id, base);
+
+	stats_count(STAT_UNIFORMS, 1);
+}
+
+// Whether the clustered lighting program is supported:
+bool
+program_light_available (void)
+{
+	return programs[LIGHT].id != 0;
+}
+
+void
+program_light_use (void)
+{
+	glUseProgram(programs[LIGHT].id);
+
+	glUniformMatrix4fv(loc_light[LOC_LIGHT_VIEW].id, 1, GL_FALSE, view_matrix());
+
+	stats_count(STAT_PROGRAMS, 1);
+	stats_count(STAT_UNIFORMS, 1);
+}
+
+// Whether the static geometry program is supported:
+bool
+program_static_available (void)
+{
+	return programs[STATIC].id != 0;
+}
+
+void
+program_static_use (void)
+{
+	glUseProgram(programs[STATIC].id);
+
+	glUniformMatrix4fv(loc_static[LOC_STATIC_VIEW].id, 1, GL_FALSE, view_matrix());
+	glUniform1i(loc_static[LOC_STATIC_MATERIALS].id, 0);
+
+	stats_count(STAT_PROGRAMS, 1);
+	stats_count(STAT_UNIFORMS, 2);
+}
+
+// Set the material layer of the static geometry program:
+void
+program_static_layer (GLint layer)
+{
+	glUniform1i(loc_static[LOC_STATIC_LAYER].id, layer);
+
+	stats_count(STAT_UNIFORMS, 1);
+}
+
+// Blur the source texture, on unit 0, along the direction given in texels,
+// and add the overlay texture, on unit 1, with the given weight:
+void
+program_post_use (float dx, float dy, float weight)
+{
+	glUseProgram(programs[POST].id);
+
+	glUniform1i(loc_post[LOC_POST_SOURCE ].id, 0);
+	glUniform1i(loc_post[LOC_POST_OVERLAY].id, 1);
+	glUniform2f(loc_post[LOC_POST_DIRECTION].id, dx, dy);
+	glUniform1f(loc_post[LOC_POST_WEIGHT].id, weight);
+
+	stats_count(STAT_PROGRAMS, 1);
+	stats_count(STAT_UNIFORMS, 4);
 }
 
 void
@@ -191,6 +509,9 @@ program_bkgd_use (void)
 	glUseProgram(programs[BKGD].id);
 
 	glUniform1i(glGetUniformLocation(programs[BKGD].id, "tex"), 0);
+
+	stats_count(STAT_PROGRAMS, 1);
+	stats_count(STAT_UNIFORMS, 1);
 }
 
 GLint
@@ -204,3 +525,15 @@ program_cube_loc (const enum LocCube index)
 {
 	return loc_cube[index].id;
 }
+
+GLint
+program_light_loc (const enum LocLight index)
+{
+	return loc_light[index].id;
+}
+
+GLint
+program_static_loc (const enum LocStatic index)
+{
+	return loc_static[index].id;
+}
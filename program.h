@@ -1,5 +1,22 @@
+#include <stdbool.h>
+
 void programs_init (void);
+void programs_compile (void);
+bool programs_ready (void);
+void programs_finish (void);
+void programs_destroy (void);
 void program_cube_use (void);
+bool program_cube_inst_available (void);
+void program_cube_inst_use (void);
+bool program_cube_mat_available (void);
+void program_cube_mat_use (void);
+void program_cube_mat_base (GLint base);
+bool program_light_available (void);
+void program_light_use (void);
+bool program_static_available (void);
+void program_static_use (void);
+void program_static_layer (GLint layer);
+void program_post_use (float dx, float dy, float weight);
 void program_bkgd_use (void);
 
 enum LocBkgd {
@@ -15,5 +32,56 @@ enum LocCube {
 	LOC_CUBE_NORMAL,
 };
 
+enum LocInst {
+	LOC_INST_VIEW,
+};
+
+enum LocMat {
+	LOC_MAT_VIEW,
+	LOC_MAT_BASE,
+	LOC_MAT_MATERIALS,
+};
+
+enum LocLight {
+	LOC_LIGHT_VIEW,
+	LOC_LIGHT_CLUSTER_DIMS,
+	LOC_LIGHT_VIEWPORT,
+	LOC_LIGHT_NEAR,
+	LOC_LIGHT_FAR,
+	LOC_LIGHT_EYE_Z,
+	LOC_LIGHT_CLUSTERED,
+	LOC_LIGHT_COUNT,
+};
+
+enum LocPost {
+	LOC_POST_SOURCE,
+	LOC_POST_OVERLAY,
+	LOC_POST_DIRECTION,
+	LOC_POST_WEIGHT,
+};
+
+enum LocStatic {
+	LOC_STATIC_VIEW,
+	LOC_STATIC_LAYER,
+	LOC_STATIC_MATERIALS,
+	LOC_STATIC_VERTEX,
+	LOC_STATIC_VCOLOR,
+	LOC_STATIC_NORMAL,
+};
+
 GLint program_bkgd_loc (const enum LocBkgd);
 GLint program_cube_loc (const enum LocCube);
+GLint program_light_loc (const enum LocLight);
+GLint program_static_loc (const enum LocStatic);
+
+// Compile and link a program, registering it with the calling module and
+// source line:
+#define program_create(owner, ...) \
+	program_create_at(owner, __FILE__, __LINE__, __VA_ARGS__)
+#define program_compute_create(owner, ...) \
+	program_compute_create_at(owner, __FILE__, __LINE__, __VA_ARGS__)
+
+GLuint program_create_at (const char *owner, const char *file, int line,
+	const uint8_t *vert, const uint8_t *vert_end, const uint8_t *frag, const uint8_t *frag_end);
+GLuint program_compute_create_at (const char *owner, const char *file, int line,
+	const uint8_t *buf, const uint8_t *end);
@@ -0,0 +1,212 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <GL/gl.h>
+
+#include "debug.h"
+#include "resource.h"
+#include "util.h"
+
+// A live GL object:
+struct resource {
+	enum resource_type	 type;
+	GLuint			 id;
+	size_t			 size;
+	const char		*owner;
+	const char		*file;
+	int			 line;
+};
+
+static struct {
+	struct resource	*items;
+	size_t		 count;
+	size_t		 alloc;
+} registry;
+
+static const char *names[] = {
+	[RESOURCE_BUFFER]       = "buffer",
+	[RESOURCE_VERTEX_ARRAY] = "vertex array",
+	[RESOURCE_TEXTURE]      = "texture",
+	[RESOURCE_RENDERBUFFER] = "renderbuffer",
+	[RESOURCE_FRAMEBUFFER]  = "framebuffer",
+	[RESOURCE_PROGRAM]      = "program",
+	[RESOURCE_QUERY]        = "query",
+};
+
+#ifdef DEBUG
+
+// Object identifiers for KHR_debug labels:
+static const GLenum identifiers[] = {
+	[RESOURCE_BUFFER]       = GL_BUFFER,
+	[RESOURCE_VERTEX_ARRAY] = GL_VERTEX_ARRAY,
+	[RESOURCE_TEXTURE]      = GL_TEXTURE,
+	[RESOURCE_RENDERBUFFER] = GL_RENDERBUFFER,
+	[RESOURCE_FRAMEBUFFER]  = GL_FRAMEBUFFER,
+	[RESOURCE_PROGRAM]      = GL_PROGRAM,
+	[RESOURCE_QUERY]        = GL_QUERY,
+};
+
+#endif
+
+static struct resource *
+find (enum resource_type type, GLuint id)
+{
+	FOREACH_NELEM (registry.items, registry.count, r)
+		if (r->type == type && r->id == id)
+			return r;
+
+	return NULL;
+}
+
+// Create a GL object of the given type and add it to the registry. Only
+// call from the thread that owns the GL context:
+GLuint
+resource_create_at (enum resource_type type, const char *owner, const char *file, int line)
+{
+	GLuint id = 0;
+
+	switch (type)
+	{
+	case RESOURCE_BUFFER:       glGenBuffers(1, &id);       break;
+	case RESOURCE_VERTEX_ARRAY: glGenVertexArrays(1, &id);  break;
+	case RESOURCE_TEXTURE:      glGenTextures(1, &id);      break;
+	case RESOURCE_RENDERBUFFER: glGenRenderbuffers(1, &id); break;
+	case RESOURCE_FRAMEBUFFER:  glGenFramebuffers(1, &id);  break;
+	case RESOURCE_PROGRAM:      id = glCreateProgram();     break;
+	case RESOURCE_QUERY:        glGenQueries(1, &id);       break;
+	default:                                                break;
+	}
+
+	if (id == 0)
+		return 0;
+
+	// Textures get their type when first bound, so are labeled later. A
+	// query likewise only exists once it has been used:
+	if (type != RESOURCE_TEXTURE && type != RESOURCE_QUERY)
+		DEBUG_LABEL(identifiers[type], id, owner, names[type]);
+
+	if (registry.count == registry.alloc) {
+		size_t alloc = registry.alloc ? registry.alloc * 2 : 64;
+		struct resource *items = realloc(registry.items, alloc * sizeof(*items));
+
+		// Still usable, just not accounted for:
+		if (items == NULL)
+			return id;
+
+		registry.items = items;
+		registry.alloc = alloc;
+	}
+
+	registry.items[registry.count++] = (struct resource) {
+		.type  = type,
+		.id    = id,
+		.owner = owner,
+		.file  = file,
+		.line  = line,
+	};
+
+	return id;
+}
+
+// Record the storage size of an object, after (re)allocating its storage:
+void
+resource_size (enum resource_type type, GLuint id, size_t bytes)
+{
+	struct resource *r = find(type, id);
+
+	if (r != NULL)
+		r->size = bytes;
+
+	if (r != NULL && type == RESOURCE_TEXTURE)
+		DEBUG_LABEL(identifiers[type], id, r->owner, names[type]);
+}
+
+// Delete a GL object and remove it from the registry:
+void
+resource_delete (enum resource_type type, GLuint id)
+{
+	if (id == 0)
+		return;
+
+	switch (type)
+	{
+	case RESOURCE_BUFFER:       glDeleteBuffers(1, &id);       break;
+	case RESOURCE_VERTEX_ARRAY: glDeleteVertexArrays(1, &id);  break;
+	case RESOURCE_TEXTURE:      glDeleteTextures(1, &id);      break;
+	case RESOURCE_RENDERBUFFER: glDeleteRenderbuffers(1, &id); break;
+	case RESOURCE_FRAMEBUFFER:  glDeleteFramebuffers(1, &id);  break;
+	case RESOURCE_PROGRAM:      glDeleteProgram(id);           break;
+	case RESOURCE_QUERY:        glDeleteQueries(1, &id);       break;
+	default:                                                   break;
+	}
+
+	struct resource *r = find(type, id);
+
+	if (r != NULL)
+		*r = registry.items[--registry.count];
+}
+
+// Whether an object is the first in the registry with its owner:
+static bool
+first_of_owner (const struct resource *r)
+{
+	for (const struct resource *q = registry.items; q < r; q++)
+		if (strcmp(q->owner, r->owner) == 0)
+			return false;
+
+	return true;
+}
+
+// Print the number and memory of live objects per type and per owner:
+void
+resource_report (void)
+{
+	size_t count[RESOURCE_TYPES] = { 0 };
+	size_t bytes[RESOURCE_TYPES] = { 0 };
+	size_t total = 0;
+
+	FOREACH_NELEM (registry.items, registry.count, r) {
+		count[r->type]++;
+		bytes[r->type] += r->size;
+		total += r->size;
+	}
+
+	printf("GL objects: %zu, %.2f KiB\n", registry.count, total / 1024.0);
+
+	puts("  By type:");
+
+	for (int i = 0; i < RESOURCE_TYPES; i++)
+		if (count[i] > 0)
+			printf("    %-14s %6zu %10.2f KiB\n", names[i], count[i], bytes[i] / 1024.0);
+
+	puts("  By owner:");
+
+	FOREACH_NELEM (registry.items, registry.count, r) {
+		size_t n = 0, size = 0;
+
+		if (!first_of_owner(r))
+			continue;
+
+		FOREACH_NELEM (r, registry.items + registry.count - r, q)
+			if (strcmp(q->owner, r->owner) == 0) {
+				n++;
+				size += q->size;
+			}
+
+		printf("    %-14s %6zu %10.2f KiB\n", r->owner, n, size / 1024.0);
+	}
+}
+
+// Print every object that is still alive with its creation site, and
+// return their number. Call after all owners are torn down:
+size_t
+resource_leaks (void)
+{
+	FOREACH_NELEM (registry.items, registry.count, r)
+		fprintf(stderr, "Leaked %s %u (%zu bytes) of %s, created at %s:%d\n",
+			names[r->type], r->id, r->size, r->owner, r->file, r->line);
+
+	return registry.count;
+}
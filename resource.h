@@ -0,0 +1,22 @@
+#include <stddef.h>
+
+enum resource_type {
+	RESOURCE_BUFFER,
+	RESOURCE_VERTEX_ARRAY,
+	RESOURCE_TEXTURE,
+	RESOURCE_RENDERBUFFER,
+	RESOURCE_FRAMEBUFFER,
+	RESOURCE_PROGRAM,
+	RESOURCE_QUERY,
+	RESOURCE_TYPES,
+};
+
+// Create a GL object, recording the calling module and source line:
+#define resource_create(type, owner) \
+	resource_create_at(type, owner, __FILE__, __LINE__)
+
+GLuint resource_create_at (enum resource_type type, const char *owner, const char *file, int line);
+void resource_size (enum resource_type type, GLuint id, size_t bytes);
+void resource_delete (enum resource_type type, GLuint id);
+void resource_report (void);
+size_t resource_leaks (void);
@@ -0,0 +1,62 @@
+#version 430
+
+layout (local_size_x = 64) in;
+
+uniform uint count;
+
+/* Per-object state: rotation axis and angular velocity, and position and
+ * rotation angle. Uniform scale is in the last vec4: */
+struct object {
+	vec4 axis_speed;
+	vec4 pos_angle;
+	vec4 scale;
+};
+
+layout (std430, binding = 0) buffer Objects {
+	object objects[];
+};
+
+layout (std430, binding = 1) writeonly buffer Matrices {
+	mat4 model_matrix[];
+};
+
+void main (void)
+{
+	uint i = gl_GlobalInvocationID.x;
+
+	if (i >= count)
+		return;
+
+	object o = objects[i];
+
+	/* Advance the angle by one frame: */
+	float angle = o.pos_angle.w + o.axis_speed.w;
+	objects[i].pos_angle.w = angle;
+
+	vec3 a = normalize(o.axis_speed.xyz);
+	float s = sin(angle);
+	float c = cos(angle);
+	float m = 1.0 - c;
+
+	/* Same element order as mat_rotate() in matrix.c: */
+	mat3 r = mat3
+		( m * a.x * a.x + c
+		, m * a.x * a.y - a.z * s
+		, m * a.z * a.x + a.y * s
+		, m * a.x * a.y + a.z * s
+		, m * a.y * a.y + c
+		, m * a.y * a.z - a.x * s
+		, m * a.z * a.x - a.y * s
+		, m * a.y * a.z + a.x * s
+		, m * a.z * a.z + c
+		) ;
+
+	r *= o.scale.x;
+
+	model_matrix[i] = mat4
+		( vec4(r[0], 0.0)
+		, vec4(r[1], 0.0)
+		, vec4(r[2], 0.0)
+		, vec4(o.pos_angle.xyz, 1.0)
+		) ;
+}
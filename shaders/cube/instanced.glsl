@@ -0,0 +1,38 @@
+#version 430
+
+uniform mat4 view_matrix;
+
+/* Per-object model matrices, written by the animation step: */
+layout (std430, binding = 1) readonly buffer Matrices {
+	mat4 model_matrix[];
+};
+
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 vcolor;
+layout (location = 2) in vec3 normal;
+
+out vec3 fcolor;
+out vec3 fpos;
+out float fdot;
+
+void main (void)
+{
+	mat4 model = model_matrix[gl_InstanceID];
+	vec4 modelspace = model * vec4(vertex, 1.0);
+
+	gl_Position = view_matrix * modelspace;
+	fcolor = vcolor;
+
+	/* Sight vector is straight down in world coords: (0, 0, -1) */
+	vec3 sight = vec3(0, 0, -1.0);
+
+	/* Transform vertex normal to world coordinates; objects are
+	 * scaled, so renormalize: */
+	vec3 wnormal = normalize(mat3(model) * normal);
+
+	/* Get cosine of the angle between sight and normal: */
+	fdot = dot(sight, wnormal);
+
+	/* Feed position to fragment shader: */
+	fpos = modelspace.xyz;
+}
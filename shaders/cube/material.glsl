@@ -0,0 +1,56 @@
+#version 430
+
+uniform mat4 view_matrix;
+
+/* Index of the first object, when drawing objects one at a time: */
+uniform int base_instance;
+
+/* Per-object model matrices, written by the animation step: */
+layout (std430, binding = 1) readonly buffer Matrices {
+	mat4 model_matrix[];
+};
+
+/* Per-object material, the texture array layer: */
+layout (std430, binding = 2) readonly buffer Materials {
+	uint material[];
+};
+
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 vcolor;
+layout (location = 2) in vec3 normal;
+
+out vec3 fcolor;
+out vec3 fpos;
+out float fdot;
+out vec3 ftex;
+
+void main (void)
+{
+	int object = base_instance + gl_InstanceID;
+	mat4 model = model_matrix[object];
+	vec4 modelspace = model * vec4(vertex, 1.0);
+
+	gl_Position = view_matrix * modelspace;
+	fcolor = vcolor;
+
+	/* Sight vector is straight down in world coords: (0, 0, -1) */
+	vec3 sight = vec3(0, 0, -1.0);
+
+	/* Transform vertex normal to world coordinates; objects are
+	 * scaled, so renormalize: */
+	vec3 wnormal = normalize(mat3(model) * normal);
+
+	/* Get cosine of the angle between sight and normal: */
+	fdot = dot(sight, wnormal);
+
+	/* Feed position to fragment shader: */
+	fpos = modelspace.xyz;
+
+	/* Project the texture along the normal's major axis: */
+	vec3 n = abs(normal);
+	vec2 uv = (n.x > n.y && n.x > n.z) ? vertex.yz
+		: (n.y > n.z) ? vertex.xz
+		: vertex.xy;
+
+	ftex = vec3(uv + 0.5, float(material[object]));
+}
@@ -3,9 +3,10 @@
 uniform mat4 view_matrix;
 uniform mat4 model_matrix;
 
-in vec3 vertex;
-in vec3 vcolor;
-in vec3 normal;
+/* Fixed locations, shared with the instanced program: */
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 vcolor;
+layout (location = 2) in vec3 normal;
 
 out vec3 fcolor;
 out vec3 fpos;
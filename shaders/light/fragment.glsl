@@ -0,0 +1,82 @@
+#version 430
+
+/* Number of clusters along x, y and z: */
+uniform uvec3 cluster_dims;
+
+/* Framebuffer size in pixels: */
+uniform vec2 viewport;
+
+/* Depth range of the clusters, and the offset from world to view z: */
+uniform float near;
+uniform float far;
+uniform float eye_z;
+
+/* Evaluate all lights instead of those in the fragment's cluster: */
+uniform bool clustered;
+uniform uint light_count;
+
+struct light {
+	vec4 pos;	/* xyz: world position, w: radius */
+	vec4 color;
+};
+
+layout (std430, binding = 3) readonly buffer Lights {
+	light lights[];
+};
+
+/* Offset into the index list and number of lights, per cluster: */
+layout (std430, binding = 4) readonly buffer Clusters {
+	uvec2 clusters[];
+};
+
+layout (std430, binding = 5) readonly buffer Indices {
+	uint indices[];
+};
+
+in vec3 fcolor;
+in vec3 fpos;
+in vec3 fnormal;
+
+out vec4 fragcolor;
+
+vec3 shade (uint i, vec3 n)
+{
+	vec3 d = lights[i].pos.xyz - fpos;
+	float dist = length(d);
+	float radius = lights[i].pos.w;
+
+	if (dist >= radius)
+		return vec3(0.0);
+
+	/* Smooth falloff to zero at the light's radius: */
+	float falloff = 1.0 - dist / radius;
+
+	return lights[i].color.rgb * max(dot(n, d / dist), 0.0) * falloff * falloff;
+}
+
+void main (void)
+{
+	if (!gl_FrontFacing)
+		return;
+
+	vec3 n = normalize(fnormal);
+
+	/* Some ambient light, so unlit objects stay visible: */
+	vec3 light = vec3(0.05);
+
+	if (clustered) {
+		/* Slices are spaced exponentially in view depth: */
+		float z = fpos.z + eye_z;
+		uint slice = uint(clamp(log(z / near) / log(far / near), 0.0, 0.999) * cluster_dims.z);
+		uvec2 tile = uvec2(clamp(gl_FragCoord.xy / viewport, 0.0, 0.999) * cluster_dims.xy);
+		uvec2 cluster = clusters[(slice * cluster_dims.y + tile.y) * cluster_dims.x + tile.x];
+
+		for (uint i = 0; i < cluster.y; i++)
+			light += shade(indices[cluster.x + i], n);
+	}
+	else
+		for (uint i = 0; i < light_count; i++)
+			light += shade(i, n);
+
+	fragcolor = vec4(fcolor * light, 0.0);
+}
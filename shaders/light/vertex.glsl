@@ -0,0 +1,30 @@
+#version 430
+
+uniform mat4 view_matrix;
+
+/* Per-object model matrices, written by the animation step: */
+layout (std430, binding = 1) readonly buffer Matrices {
+	mat4 model_matrix[];
+};
+
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 vcolor;
+layout (location = 2) in vec3 normal;
+
+out vec3 fcolor;
+out vec3 fpos;
+out vec3 fnormal;
+
+void main (void)
+{
+	mat4 model = model_matrix[gl_InstanceID];
+	vec4 modelspace = model * vec4(vertex, 1.0);
+
+	gl_Position = view_matrix * modelspace;
+	fcolor = vcolor;
+
+	/* World position and normal, for lighting in the fragment shader;
+	 * objects are scaled, so renormalize: */
+	fpos = modelspace.xyz;
+	fnormal = normalize(mat3(model) * normal);
+}
@@ -0,0 +1,10 @@
+#version 430
+
+flat in uint id;
+
+out uint fragid;
+
+void main (void)
+{
+	fragid = id;
+}
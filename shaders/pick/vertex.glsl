@@ -0,0 +1,24 @@
+#version 430
+
+uniform mat4 view_matrix;
+uniform mat4 model_matrix;
+uniform bool instanced;
+
+/* Per-object model matrices, written by the animation step: */
+layout (std430, binding = 1) readonly buffer Matrices {
+	mat4 matrices[];
+};
+
+layout (location = 0) in vec3 vertex;
+
+flat out uint id;
+
+void main (void)
+{
+	mat4 model = instanced ? matrices[gl_InstanceID] : model_matrix;
+
+	gl_Position = view_matrix * model * vec4(vertex, 1.0);
+
+	/* Zero means no object: */
+	id = gl_InstanceID + 1;
+}
@@ -0,0 +1,22 @@
+#version 150
+
+uniform sampler2D source;
+uniform sampler2D overlay;
+uniform vec2 direction;		// Blur direction in texels; zero to copy
+uniform float weight;		// Weight of the overlay added on top
+
+in vec2 ftex;
+
+out vec4 fragcolor;
+
+void main (void)
+{
+	vec2 texel = direction / vec2(textureSize(source, 0));
+
+	// Five-tap binomial blur along the direction:
+	vec4 sum = texture(source, ftex) * 0.375
+		+ (texture(source, ftex - texel) + texture(source, ftex + texel)) * 0.25
+		+ (texture(source, ftex - 2.0 * texel) + texture(source, ftex + 2.0 * texel)) * 0.0625;
+
+	fragcolor = sum + weight * texture(overlay, ftex);
+}
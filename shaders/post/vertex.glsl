@@ -0,0 +1,10 @@
+#version 150
+
+out vec2 ftex;
+
+void main (void)
+{
+	// One triangle covering the screen, made from the vertex index:
+	ftex = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(ftex * 2.0 - 1.0, 0.0, 1.0);
+}
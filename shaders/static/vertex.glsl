@@ -0,0 +1,36 @@
+#version 330
+
+uniform mat4 view_matrix;
+
+/* Material layer of the current batch: */
+uniform int layer;
+
+/* Static geometry is stored in world coordinates: */
+layout (location = 0) in vec3 vertex;
+layout (location = 1) in vec3 vcolor;
+layout (location = 2) in vec3 normal;
+
+out vec3 fcolor;
+out vec3 fpos;
+out float fdot;
+out vec3 ftex;
+
+void main (void)
+{
+	gl_Position = view_matrix * vec4(vertex, 1.0);
+	fcolor = vcolor;
+
+	/* Sight vector is straight down in world coords: (0, 0, -1) */
+	fdot = dot(vec3(0, 0, -1.0), normal);
+
+	/* Feed position to fragment shader: */
+	fpos = vertex;
+
+	/* Project the texture along the normal's major axis: */
+	vec3 n = abs(normal);
+	vec2 uv = (n.x > n.y && n.x > n.z) ? vertex.yz
+		: (n.y > n.z) ? vertex.xz
+		: vertex.xy;
+
+	ftex = vec3(uv * 8.0, float(layer));
+}
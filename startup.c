@@ -0,0 +1,210 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <GL/gl.h>
+#include <glib.h>
+
+#include "background.h"
+#include "debug.h"
+#include "model.h"
+#include "program.h"
+#include "util.h"
+
+// Startup stages, in dependency order:
+enum {
+	STAGE_SHADERS,
+	STAGE_DECODE,
+	STAGE_MESH,
+	STAGE_TEXTURE,
+	STAGE_VBO,
+	STAGE_FRAME,
+	STAGE_COUNT,
+};
+
+struct stage {
+	const char	*name;
+	void		(*run) (void);
+	bool		 worker;
+	int		 deps[2];
+	int		 ndeps;
+	gint64		 start;
+	gint64		 end;
+	bool		 done;
+	GThread		*thread;
+};
+
+// Whether build_mesh left any geometry to draw:
+static bool mesh_built;
+
+// Build the selected model, or the cube if that fails:
+static void
+build_mesh (void)
+{
+	mesh_built = model_build() || model_build_cube();
+}
+
+// Decode the background image; without it, the background stays black:
+static void
+decode_background (void)
+{
+	if (!background_decode())
+		fputs("Drawing without a background image\n", stderr);
+}
+
+static struct stage stages[STAGE_COUNT] = {
+	[STAGE_SHADERS] = { "shaders", programs_finish,   false },
+	[STAGE_DECODE]  = { "decode",  decode_background, true  },
+	[STAGE_MESH]    = { "mesh",    build_mesh,        true  },
+	[STAGE_TEXTURE] = { "texture", background_upload, false, { STAGE_DECODE }, 1 },
+	[STAGE_VBO]     = { "vbo",     model_upload,      false, { STAGE_SHADERS, STAGE_MESH }, 2 },
+	[STAGE_FRAME]   = { "frame",   NULL,              false, { STAGE_TEXTURE, STAGE_VBO  }, 2 },
+};
+
+static gint64 origin;
+static GAsyncQueue *queue;
+
+static gpointer
+worker (gpointer data)
+{
+	struct stage *s = data;
+
+	s->start = g_get_monotonic_time();
+	s->run();
+	s->end = g_get_monotonic_time();
+
+	// Signal the GL thread:
+	g_async_queue_push(queue, s);
+	return NULL;
+}
+
+static void
+run_stage (struct stage *s)
+{
+	DEBUG_PUSH(s->name);
+	s->start = g_get_monotonic_time();
+	s->run();
+	s->end = g_get_monotonic_time();
+	DEBUG_POP();
+	s->done = true;
+}
+
+static bool
+done (int stage)
+{
+	return stages[stage].done;
+}
+
+// Run all init stages. CPU-only stages run on worker threads while the
+// shaders compile; each GL upload happens as soon as its inputs are ready.
+// Fails if not even the cube could be built:
+bool
+startup_run (void)
+{
+	int pending = 0;
+
+	origin = g_get_monotonic_time();
+	queue  = g_async_queue_new();
+
+	// Run all stages again when the GL area is realized again:
+	FOREACH (stages, s)
+		s->done = false;
+
+	// Shader compilation starts now and is finished later:
+	stages[STAGE_SHADERS].start = origin;
+	programs_compile();
+
+	FOREACH (stages, s)
+		if (s->worker) {
+			s->thread = g_thread_new(s->name, worker, s);
+			pending++;
+		}
+
+	for (;;) {
+		// Finish the programs when they are ready, or when nothing
+		// else is left to wait for:
+		if (!done(STAGE_SHADERS) && (pending == 0 || programs_ready())) {
+			DEBUG_PUSH(stages[STAGE_SHADERS].name);
+			programs_finish();
+			DEBUG_POP();
+			stages[STAGE_SHADERS].end  = g_get_monotonic_time();
+			stages[STAGE_SHADERS].done = true;
+		}
+
+		if (done(STAGE_DECODE) && !done(STAGE_TEXTURE))
+			run_stage(&stages[STAGE_TEXTURE]);
+
+		if (done(STAGE_SHADERS) && done(STAGE_MESH) && !done(STAGE_VBO))
+			run_stage(&stages[STAGE_VBO]);
+
+		if (done(STAGE_TEXTURE) && done(STAGE_VBO))
+			break;
+
+		if (pending == 0)
+			continue;
+
+		// Wait for a worker, but keep polling the shaders:
+		struct stage *s = done(STAGE_SHADERS)
+			? g_async_queue_pop(queue)
+			: g_async_queue_timeout_pop(queue, 500);
+
+		if (s != NULL) {
+			g_thread_join(s->thread);
+			s->done = true;
+			pending--;
+		}
+	}
+
+	g_async_queue_unref(queue);
+
+	// The first frame starts when the GL area gets to render:
+	stages[STAGE_FRAME].start = g_get_monotonic_time();
+	return mesh_built;
+}
+
+static void
+print_path (int stage)
+{
+	const struct stage *s = &stages[stage];
+	int last = -1;
+
+	// The critical dependency is the one that finished last:
+	for (int i = 0; i < s->ndeps; i++)
+		if (last < 0 || stages[s->deps[i]].end > stages[last].end)
+			last = s->deps[i];
+
+	if (last >= 0) {
+		print_path(last);
+		fputs(" -> ", stdout);
+	}
+
+	fputs(s->name, stdout);
+}
+
+// Called after every frame; prints the startup timeline after the first:
+void
+startup_frame_done (void)
+{
+	struct stage *frame = &stages[STAGE_FRAME];
+
+	if (frame->done)
+		return;
+
+	// Make sure the frame is really done:
+	glFinish();
+	frame->end  = g_get_monotonic_time();
+	frame->done = true;
+
+	puts("Startup timeline (ms):");
+
+	FOREACH (stages, s)
+		printf("  %-8s %8.2f %8.2f%s\n", s->name,
+			(s->start - origin) / 1000.0,
+			(s->end   - origin) / 1000.0,
+			s->worker ? "  (worker)" : "");
+
+	printf("Time to first frame: %.2f ms\n", (frame->end - origin) / 1000.0);
+
+	fputs("Critical path: ", stdout);
+	print_path(STAGE_FRAME);
+	putchar('\n');
+}
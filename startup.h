@@ -0,0 +1,4 @@
+#include <stdbool.h>
+
+bool startup_run (void);
+void startup_frame_done (void);
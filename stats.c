@@ -0,0 +1,40 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "stats.h"
+
+static size_t counts[STAT_COUNT];
+
+static const char *names[] = {
+	[STAT_DRAWS]         = "draws",
+	[STAT_PROGRAMS]      = "programs",
+	[STAT_TEXTURES]      = "textures",
+	[STAT_BUFFERS]       = "buffers",
+	[STAT_VERTEX_ARRAYS] = "vertex_arrays",
+	[STAT_UNIFORMS]      = "uniforms",
+};
+
+void
+stats_count (enum stat stat, size_t n)
+{
+	counts[stat] += n;
+}
+
+// Copy out all counters, indexed by enum stat:
+void
+stats_get (size_t *out)
+{
+	memcpy(out, counts, sizeof(counts));
+}
+
+void
+stats_reset (void)
+{
+	memset(counts, 0, sizeof(counts));
+}
+
+const char *
+stats_name (enum stat stat)
+{
+	return names[stat];
+}
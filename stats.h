@@ -0,0 +1,17 @@
+#include <stddef.h>
+
+// Render state changes, counted where the draw code makes them:
+enum stat {
+	STAT_DRAWS,
+	STAT_PROGRAMS,
+	STAT_TEXTURES,
+	STAT_BUFFERS,
+	STAT_VERTEX_ARRAYS,
+	STAT_UNIFORMS,
+	STAT_COUNT,
+};
+
+void stats_count (enum stat stat, size_t n);
+void stats_get (size_t *counts);
+void stats_reset (void);
+const char *stats_name (enum stat stat);
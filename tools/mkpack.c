@@ -0,0 +1,164 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lz.h"
+#include "../pack.h"
+
+// An input file:
+struct asset {
+	const char	*path;
+	uint8_t		*data;
+	size_t		 size;
+	uint8_t		*packed;
+	size_t		 packed_size;
+};
+
+static uint8_t *
+read_file (const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *data;
+	long len;
+
+	if (f == NULL) {
+		perror(path);
+		return NULL;
+	}
+
+	if (fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+		perror(path);
+		fclose(f);
+		return NULL;
+	}
+
+	if ((data = malloc(len ? len : 1)) == NULL || fread(data, 1, len, f) != (size_t) len) {
+		fprintf(stderr, "Could not read %s\n", path);
+		free(data);
+		fclose(f);
+		return NULL;
+	}
+
+	fclose(f);
+	*size = len;
+	return data;
+}
+
+static int
+compare (const void *a, const void *b)
+{
+	return strcmp(((const struct asset *) a)->path, ((const struct asset *) b)->path);
+}
+
+// Compress each asset, and keep it only if that saves space:
+static bool
+pack_asset (struct asset *a)
+{
+	size_t cap = a->size;
+
+	if ((a->packed = malloc(cap ? cap : 1)) == NULL)
+		return false;
+
+	a->packed_size = lz_compress(a->data, a->size, a->packed, cap);
+
+	// Check the round trip:
+	if (a->packed_size > 0 && a->packed_size < a->size) {
+		uint8_t *check = malloc(a->size);
+		bool ok = check != NULL
+		       && lz_decompress(a->packed, a->packed_size, check, a->size)
+		       && memcmp(check, a->data, a->size) == 0;
+
+		free(check);
+
+		if (!ok) {
+			fprintf(stderr, "Compression round trip failed for %s\n", a->path);
+			return false;
+		}
+	}
+	else
+		a->packed_size = 0;
+
+	return true;
+}
+
+// Build an asset pack from the given files, named by their paths:
+int
+main (int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s output [files...]\n", argv[0]);
+		return 1;
+	}
+
+	size_t count = argc - 2;
+	struct asset *assets = calloc(count ? count : 1, sizeof(*assets));
+	size_t raw = 0, packed = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		struct asset *a = &assets[i];
+
+		a->path = argv[i + 2];
+
+		if (strlen(a->path) >= sizeof(((struct pack_entry *) 0)->name)) {
+			fprintf(stderr, "Asset name too long: %s\n", a->path);
+			return 1;
+		}
+
+		if ((a->data = read_file(a->path, &a->size)) == NULL || !pack_asset(a))
+			return 1;
+	}
+
+	// Sorted, so that entries can be found by binary search:
+	qsort(assets, count, sizeof(*assets), compare);
+
+	struct pack_header header = { .version = PACK_VERSION, .count = count };
+	uint32_t offset = sizeof(header) + count * sizeof(struct pack_entry);
+	FILE *f = fopen(argv[1], "wb");
+
+	memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+
+	if (f == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	fwrite(&header, sizeof(header), 1, f);
+
+	for (size_t i = 0; i < count; i++) {
+		const struct asset *a = &assets[i];
+		struct pack_entry e = {
+			.offset   = offset,
+			.size     = a->packed_size ? a->packed_size : a->size,
+			.raw_size = a->size,
+			.codec    = a->packed_size ? PACK_LZ : PACK_RAW,
+		};
+
+		strcpy(e.name, a->path);
+		fwrite(&e, sizeof(e), 1, f);
+		offset += e.size;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		const struct asset *a = &assets[i];
+
+		if (a->packed_size)
+			fwrite(a->packed, a->packed_size, 1, f);
+		else
+			fwrite(a->data, a->size, 1, f);
+
+		raw    += a->size;
+		packed += a->packed_size ? a->packed_size : a->size;
+	}
+
+	if (fclose(f) != 0) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	printf("Packed %zu assets: %zu bytes, %zu compressed, %u with index\n",
+		count, raw, packed, offset);
+
+	return 0;
+}
@@ -0,0 +1,193 @@
+#ifdef TRACE
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define CHUNK_EVENTS	4096
+
+// Events are only written at exit, so each thread's buffer is a ring of at
+// most this many chunks, about 24 MiB. Once it is full, the oldest chunk is
+// reused, so that a long session keeps its most recent events:
+#define MAX_CHUNKS	256
+
+struct event {
+	const char	*name;
+	uint64_t	 ts;
+	char		 phase;
+};
+
+// Events are appended to fixed-size chunks; a full chunk is only touched
+// again when the ring wraps around, so growing the buffer needs no copying:
+struct chunk {
+	struct chunk	*next;
+	size_t		 count;
+	struct event	 event[CHUNK_EVENTS];
+};
+
+// Each thread owns one buffer, so recording an event takes no locks:
+struct buffer {
+	struct buffer	*next;
+	struct chunk	*head;
+	struct chunk	*tail;
+	size_t		 nchunks;
+	size_t		 dropped;	// Overwritten, or lost to failed allocations
+	int		 tid;
+};
+
+// Lock-free list of all thread buffers:
+static struct buffer *buffers = NULL;
+static int next_tid = 0;
+
+static __thread struct buffer *local = NULL;
+
+static uint64_t
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+write_trace (void)
+{
+	const char *path = getenv("GTK3_OPENGL_TRACE");
+	FILE *f = fopen(path ? path : "trace.json", "w");
+	const char *sep = "";
+
+	if (f == NULL) {
+		perror("Could not write trace");
+		return;
+	}
+
+	fputs("{\"traceEvents\":[\n", f);
+
+	for (struct buffer *b = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); b; b = b->next) {
+		size_t depth = 0;
+
+		for (struct chunk *c = __atomic_load_n(&b->head, __ATOMIC_ACQUIRE); c; c = c->next) {
+			size_t count = __atomic_load_n(&c->count, __ATOMIC_ACQUIRE);
+
+			for (size_t i = 0; i < count; i++) {
+				const struct event *e = &c->event[i];
+
+				// Skip the ends of scopes whose begin was overwritten:
+				if (e->phase == 'E' && depth == 0)
+					continue;
+
+				depth += e->phase == 'B' ? 1 : -1;
+
+				fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+					sep, e->name, e->phase, e->ts / 1000.0, b->tid);
+				sep = ",\n";
+			}
+		}
+	}
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+	fclose(f);
+
+	for (struct buffer *b = __atomic_load_n(&buffers, __ATOMIC_ACQUIRE); b; b = b->next)
+		if (b->dropped > 0)
+			fprintf(stderr, "Trace dropped the oldest %zu events of thread %d, over the limit of %d\n",
+				b->dropped, b->tid, MAX_CHUNKS * CHUNK_EVENTS);
+}
+
+static struct chunk *
+chunk_new (void)
+{
+	struct chunk *c = malloc(sizeof(*c));
+
+	if (c == NULL)
+		return NULL;
+
+	c->next  = NULL;
+	c->count = 0;
+	return c;
+}
+
+static struct buffer *
+buffer_new (void)
+{
+	struct buffer *b = malloc(sizeof(*b));
+
+	if (b == NULL)
+		return NULL;
+
+	if ((b->head = b->tail = chunk_new()) == NULL) {
+		free(b);
+		return NULL;
+	}
+
+	b->nchunks = 1;
+	b->dropped = 0;
+	b->tid  = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
+
+	// The first thread to trace registers the writer:
+	if (b->tid == 0)
+		atexit(write_trace);
+
+	// Push onto the global list:
+	b->next = __atomic_load_n(&buffers, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&buffers, &b->next, b, true,
+			__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+
+	return b;
+}
+
+void
+trace_event (const char *name, char phase)
+{
+	if (local == NULL && (local = buffer_new()) == NULL)
+		return;
+
+	struct chunk *c = local->tail;
+
+	if (c->count == CHUNK_EVENTS) {
+		if (local->nchunks < MAX_CHUNKS && (c = chunk_new()) != NULL)
+			local->nchunks++;
+
+		// Full, or out of memory: move the oldest chunk to the end.
+		// The writer skips the ends of scopes that lost their begin:
+		else if (local->nchunks > 1) {
+			c = local->head;
+			__atomic_store_n(&local->head, c->next, __ATOMIC_RELEASE);
+			local->dropped += c->count;
+			c->next  = NULL;
+			c->count = 0;
+		}
+		else {
+			local->dropped++;
+			return;
+		}
+
+		__atomic_store_n(&local->tail->next, c, __ATOMIC_RELEASE);
+		local->tail = c;
+	}
+
+	c->event[c->count] = (struct event) {
+		.name  = name,
+		.ts    = now(),
+		.phase = phase,
+	};
+
+	// Publish the event to the writer:
+	__atomic_store_n(&c->count, c->count + 1, __ATOMIC_RELEASE);
+}
+
+void
+trace_scope_end (const char **name)
+{
+	trace_event(*name, 'E');
+}
+
+#endif
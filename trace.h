@@ -0,0 +1,31 @@
+// Scoped trace events, written as Chrome trace JSON at exit. Enabled by
+// building with -DTRACE; otherwise the macros compile to nothing.
+
+#ifdef TRACE
+
+void trace_event (const char *name, char phase);
+void trace_scope_end (const char **name);
+
+#define TRACE_CONCAT_(a, b)	a ## b
+#define TRACE_CONCAT(a, b)	TRACE_CONCAT_(a, b)
+
+// Mark the begin and end of a stage; name must be a static string:
+#define TRACE_BEGIN(name)	trace_event((name), 'B')
+#define TRACE_END(name)		trace_event((name), 'E')
+
+// Trace until the end of the enclosing block:
+#define TRACE_SCOPE(name)						\
+	__attribute__((cleanup(trace_scope_end)))			\
+	const char *TRACE_CONCAT(trace_scope_, __LINE__) =		\
+		(trace_event((name), 'B'), (name))
+
+#else
+
+#define TRACE_BEGIN(name)	do { } while (0)
+#define TRACE_END(name)		do { } while (0)
+#define TRACE_SCOPE(name)	do { } while (0)
+
+#endif
+
+// Trace the enclosing function:
+#define TRACE_FUNC()		TRACE_SCOPE(__func__)
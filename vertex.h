@@ -0,0 +1,18 @@
+struct point {
+	float x;
+	float y;
+	float z;
+} __attribute__((packed));
+
+struct color {
+	float r;
+	float g;
+	float b;
+} __attribute__((packed));
+
+// Each vertex has position, normal and color:
+struct vertex {
+	struct point pos;
+	struct point normal;
+	struct color color;
+} __attribute__((packed));
@@ -1,4 +1,12 @@
+#include <math.h>
+
 #include "matrix.h"
+#include "view.h"
+
+// Frustum parameters:
+#define ANGLE	0.7f
+#define NEAR	0.5f
+#define FAR	6.0f
 
 static struct {
 	float matrix[16];
@@ -16,6 +24,27 @@ view_matrix (void)
 	return state.matrix;
 }
 
+void
+view_window_size (float *width, float *height)
+{
+	*width  = state.width;
+	*height = state.height;
+}
+
+// Get the frustum in view space, where the eye is at the origin looking
+// down +z and world coordinates are shifted by eye_z along z:
+void
+view_frustum (struct view_frustum *f)
+{
+	f->near  = NEAR;
+	f->far   = FAR;
+	f->eye_z = state.z;
+
+	// Matches the scale factors of mat_frustum():
+	f->tan_x = tanf(ANGLE);
+	f->tan_y = tanf(ANGLE) * state.height / state.width;
+}
+
 static void
 view_recalc (void)
 {
@@ -24,7 +53,7 @@ view_recalc (void)
 	float matrix_translate[16];
 
 	// Create frustum matrix:
-	mat_frustum(matrix_frustum, 0.7, aspect_ratio, 0.5, 6);
+	mat_frustum(matrix_frustum, ANGLE, aspect_ratio, NEAR, FAR);
 
 	// Create frustum translation matrix:
 	mat_translate(matrix_translate, 0, 0, state.z);
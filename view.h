@@ -1,4 +1,15 @@
+// View frustum, for binning into view-space clusters:
+struct view_frustum {
+	float	near;
+	float	far;
+	float	tan_x;
+	float	tan_y;
+	float	eye_z;
+};
+
 const float *view_matrix (void);
+void view_frustum (struct view_frustum *frustum);
 void view_set_window (int width, int height);
 void view_z_decrease (void);
 void view_z_increase (void);
+void view_window_size (float *width, float *height);